@@ -1,37 +1,126 @@
 #include "BigQ.h"
 #include "Utilities.h"
+#include <chrono>
+#include <unistd.h>
+#include <fcntl.h>
 using namespace std;
 
+// returns the seconds elapsed since start
+static double SecondsSince(chrono::steady_clock::time_point start){
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
 // ------------------------------------------------------------------
 void* BigQ :: Driver(void *p){
   BigQ * ptr = (BigQ*) p;
+  BigQStats &stats = ptr->myStats;
+  if(ptr->myThreadData.options.limit > 0){
+      chrono::steady_clock::time_point start = chrono::steady_clock::now();
+      ptr->TopK();
+      stats.phase1Seconds = SecondsSince(start);
+      ptr->myThreadData.out->ShutDown();
+      return NULL;
+  }
+  ptr->mySpillFile->Open(ptr->f_path);
+  chrono::steady_clock::time_point start = chrono::steady_clock::now();
   ptr->Phase1();
+  stats.phase1Seconds = SecondsSince(start);
+  start = chrono::steady_clock::now();
   ptr->Phase2();
+  stats.phase2Seconds = SecondsSince(start);
+  ptr->NegotiateMemory(0,0);
+  stats.spillBytesRaw = ptr->mySpillFile->rawBytes;
+  stats.spillBytesWritten = ptr->mySpillFile->storedBytes;
+  stats.spillBytesRead = ptr->mySpillFile->readBytes;
+  stats.codecSeconds = ptr->mySpillFile->codecSeconds;
+  stats.ioSeconds = ptr->mySpillFile->ioSeconds;
+  ptr->mySpillFile->Close();
   ptr->myThreadData.out->ShutDown();
+  return NULL;
+}
+// gives back the memory held from the governor and asks for bytes instead
+int BigQ :: NegotiateMemory(long long bytes, long long minimum)
+{
+    MemoryGovernor * governor = this->myThreadData.options.governor;
+    if(governor == NULL){
+        return this->myThreadData.runlen;
+    }
+    int memoryId = this->myThreadData.options.memoryId;
+    governor->Release(memoryId,heldBytes);
+    heldBytes = bytes > 0 ? governor->Acquire(memoryId,bytes,minimum) : 0;
+    return heldBytes / PAGE_SIZE;
+}
+
+// the bytes this sort plans with, its part of a shared account or the whole share
+long long BigQ :: GetShare()
+{
+    SortOptions &options = this->myThreadData.options;
+    if(options.memoryShare > 0){
+        return options.memoryShare;
+    }
+    return options.governor->GetShare(options.memoryId);
+}
+
+int BigQ :: RemoveInput(Record * rec)
+{
+    if(inputPosition == inputCount){
+        inputCount = this->myThreadData.in->Remove(inputBatch,BIGQ_INPUT_BATCH);
+        inputPosition = 0;
+        if(inputCount == 0){
+            return 0;
+        }
+    }
+    rec->Consume(&inputBatch[inputPosition++]);
+    return 1;
 }
+
 void BigQ :: Phase1()
 {
     Record tRec;
-    run tRun(this->myThreadData.runlen,this->myThreadData.sortorder,this->f_path);
+    // at every run boundary ask for the larger of runlen and the planned share
+    long long wanted = (long long) this->myThreadData.runlen * PAGE_SIZE;
+    if(this->myThreadData.options.governor != NULL){
+        wanted = max(wanted,GetShare());
+    }
+    run tRun(NegotiateMemory(wanted,PAGE_SIZE),this->myThreadData.sortorder,this->f_path);
 
     // add 1 page for adding records
     long long int pageCount=0;
     long long int runCount=1;
     tRun.AddPage();
     bool diff = false;
-    int cnt=0;
+    long long int cnt=0;
     // read data from in pipe sort them into runlen pages
 
-    while(this->myThreadData.in->Remove(&tRec)) {
+    while(this->RemoveInput(&tRec)) {
         cnt++;
+        if(myFolder!=NULL){
+            myFolder->Prepare(&tRec);
+        }
         if(!tRun.addRecordAtPage(pageCount, &tRec)) {
             if (tRun.checkRunFull()) {
                 sortCompleteRun(&tRun, this->myThreadData.sortorder);
-                diff = tRun.writeRunToFile(&this->myFile);
+                // folding may shrink the run enough to keep filling it in memory
+                if (myFolder!=NULL && tRun.getRunSize() <= tRun.getRunLength()/2) {
+                    pageCount = tRun.getRunSize()-1;
+                    if(!tRun.addRecordAtPage(pageCount, &tRec)){
+                        tRun.AddPage();
+                        pageCount++;
+                        tRun.addRecordAtPage(pageCount, &tRec);
+                    }
+                    continue;
+                }
+                diff = tRun.writeRunToFile(this->mySpillFile);
+                tRun.setRunLength(NegotiateMemory(wanted,PAGE_SIZE));
                 if (diff){
                     pageCount= 0;
                     runCount++;
-                    tRun.addRecordAtPage(pageCount, &tRec);
+                    // the page carried over to the next run may already be full
+                    if(!tRun.addRecordAtPage(pageCount, &tRec)){
+                        tRun.AddPage();
+                        pageCount++;
+                        tRun.addRecordAtPage(pageCount, &tRec);
+                    }
                 }
                 else{
                     tRun.clearPages();
@@ -49,45 +138,199 @@ void BigQ :: Phase1()
     }
     if(tRun.getRunSize()!=0) {
         sortCompleteRun(&tRun, this->myThreadData.sortorder);
-        tRun.writeRunToFile(&this->myFile);
+        tRun.writeRunToFile(this->mySpillFile);
         tRun.clearPages();
     }
     this->totalRuns = runCount;
+    myStats.recordsIn = cnt;
+    myStats.runs = this->mySpillFile->GetNoOfRuns();
+    if(myStats.runs > 0){
+        myStats.averageRunLength = (double) this->mySpillFile->GetLength() / myStats.runs;
+    }
+}
+
+// keep the smallest limit records in a max-heap, nothing is spilled to disk
+void BigQ :: TopK()
+{
+    unsigned int limit = this->myThreadData.options.limit;
+    CustomComparator comparator(this->myThreadData.sortorder,&myStats.comparisons);
+    priority_queue<Record*,vector<Record*>,CustomComparator> heap(comparator);
+    Record tRec;
+    while(this->RemoveInput(&tRec)) {
+        myStats.recordsIn++;
+        if(heap.size() < limit){
+            Record * heapRecord = new Record();
+            heapRecord->Consume(&tRec);
+            heap.push(heapRecord);
+        }
+        // replace the largest record kept so far if the new one is smaller
+        else if(comparator(&tRec,heap.top())){
+            Record * heapRecord = heap.top();
+            heap.pop();
+            heapRecord->Consume(&tRec);
+            heap.push(heapRecord);
+        }
+    }
+    // the heap pops the largest record first, so fill the output from the back
+    vector<Record*> sorted(heap.size());
+    myStats.recordsOut = sorted.size();
+    for(int i = sorted.size()-1; i>=0; i--){
+        sorted[i] = heap.top();
+        heap.pop();
+    }
+    for(vector<Record*>::iterator i = sorted.begin() ; i!=sorted.end() ; ++i){
+        this->myThreadData.out->Insert(*(i));
+        delete *(i);
+    }
 }
 
 // sort runs from file using Run Manager
 void BigQ :: Phase2()
 {
     int cnt=0;
-    RunManager runManager(this->myThreadData.runlen,this->f_path);
-    myTree = new TournamentTree(&runManager,this->myThreadData.sortorder);
+    // merging holds one page per run and the output buffer; when the governor
+    // can not grant that much the runs are merged in several passes
+    int noOfRuns = this->mySpillFile->GetNoOfRuns();
+    long long wanted = (long long) (noOfRuns+1) * PAGE_SIZE;
+    // a sort sharing its account must leave the rest of it to the others
+    if(this->myThreadData.options.memoryShare > 0){
+        wanted = min(wanted,max(GetShare(),(long long) 3 * PAGE_SIZE));
+    }
+    int fanIn = NegotiateMemory(wanted,3 * PAGE_SIZE) - 1;
+    if(this->myThreadData.options.governor != NULL){
+        while(fanIn < this->mySpillFile->GetNoOfRuns()){
+            MergePass(fanIn);
+            myStats.mergePasses++;
+        }
+    }
+    myStats.mergeFanIn = this->mySpillFile->GetNoOfRuns();
+    myStats.mergePasses++;
+    RunManager runManager(this->myThreadData.runlen,this->mySpillFile);
+    myTree = new TournamentTree(&runManager,this->myThreadData.sortorder,&myStats.comparisons);
     Page * tempPage;
+    Record foldedRecord;
     while(myTree->GetSortedPage(&tempPage)){
         Record tempRecord;
         while(tempPage->GetFirst(&tempRecord)){
-            this->myThreadData.out->Insert(&tempRecord);
-            cnt++;
+            if(myFolder==NULL){
+                this->myThreadData.out->Insert(&tempRecord);
+                cnt++;
+            }
+            else if(myFolder->Push(&tempRecord,&foldedRecord)){
+                this->myThreadData.out->Insert(&foldedRecord);
+                cnt++;
+            }
         }
         myTree->RefillOutputBuffer();
     }
+    if(myFolder!=NULL && myFolder->Flush(&foldedRecord)){
+        this->myThreadData.out->Insert(&foldedRecord);
+        cnt++;
+    }
+    myStats.recordsOut = cnt;
+}
+
+// appends rec to page, spilling the page to file once it is full
+static void AppendToSpill(SpillFile *file, Page *page, Record *rec) {
+    if(!page->Append(rec)){
+        file->AddPage(page);
+        page->EmptyItOut();
+        page->Append(rec);
+    }
+}
+
+// merges every fanIn runs of the spill file into one run of a new spill file,
+// folding equal keys again so that later passes read fewer records
+void BigQ :: MergePass(int fanIn)
+{
+    char * passPath = Utilities::newRandomFileName(".xbin");
+    SpillFile * passFile = new SpillFile(this->myThreadData.options.compressRuns);
+    passFile->Open(passPath);
+    Page outPage;
+    Record foldedRecord;
+    int noOfRuns = this->mySpillFile->GetNoOfRuns();
+    for(int firstRun = 0; firstRun < noOfRuns; firstRun += fanIn){
+        RunManager runManager(this->mySpillFile,firstRun,min(fanIn,noOfRuns-firstRun));
+        TournamentTree tree(&runManager,this->myThreadData.sortorder,&myStats.comparisons);
+        Page * tempPage;
+        while(tree.GetSortedPage(&tempPage)){
+            Record tempRecord;
+            while(tempPage->GetFirst(&tempRecord)){
+                if(myFolder==NULL){
+                    AppendToSpill(passFile,&outPage,&tempRecord);
+                }
+                else if(myFolder->Push(&tempRecord,&foldedRecord)){
+                    AppendToSpill(passFile,&outPage,&foldedRecord);
+                }
+            }
+            tree.RefillOutputBuffer();
+        }
+        // a key never spans two runs of the new file
+        if(myFolder!=NULL && myFolder->Flush(&foldedRecord)){
+            AppendToSpill(passFile,&outPage,&foldedRecord);
+        }
+        if(outPage.getNumRecs()>0){
+            passFile->AddPage(&outPage);
+            outPage.EmptyItOut();
+        }
+        passFile->EndRun();
+    }
+
+    // keep the statistics of every pass in the report
+    passFile->rawBytes += this->mySpillFile->rawBytes;
+    passFile->storedBytes += this->mySpillFile->storedBytes;
+    passFile->readBytes += this->mySpillFile->readBytes;
+    passFile->codecSeconds += this->mySpillFile->codecSeconds;
+    passFile->ioSeconds += this->mySpillFile->ioSeconds;
+
+    this->mySpillFile->Close();
+    delete this->mySpillFile;
+    remove(this->f_path);
+    delete [] this->f_path;
+    this->mySpillFile = passFile;
+    this->f_path = passPath;
+}
+
+// appends rec to page, handing the page over to the run once it is full
+static Page * AppendToRun(run *run, Page *page, Record *rec) {
+    if(!page->Append(rec)){
+        run->AddPage(page);
+        page = new Page();
+        page->Append(rec);
+    }
+    return page;
 }
 
 void BigQ::sortCompleteRun(run *run, OrderMaker *sortorder) {
-    myTree = new TournamentTree(run,sortorder);
+    myTree = new TournamentTree(run,sortorder,&myStats.comparisons);
     Page * tempPage;
     // as run was swapped by tournament tree
     // we need to allocate space for pages again
     // these pages will be part of complete sorted run
     // add 1 page for adding records
+    Page * pushPage = new Page();
+    Record foldedRecord;
     while(myTree->GetSortedPageForRun(&tempPage)){
         Record tempRecord;
-        Page * pushPage = new Page();
         while(tempPage->GetFirst(&tempRecord)){
-            pushPage->Append(&tempRecord);
+            if(myFolder==NULL){
+                pushPage = AppendToRun(run,pushPage,&tempRecord);
+            }
+            else if(myFolder->Push(&tempRecord,&foldedRecord)){
+                pushPage = AppendToRun(run,pushPage,&foldedRecord);
+            }
         }
-        run->AddPage(pushPage);
         myTree->RefillOutputBufferForRun();
     }
+    if(myFolder!=NULL && myFolder->Flush(&foldedRecord)){
+        pushPage = AppendToRun(run,pushPage,&foldedRecord);
+    }
+    if(pushPage->getNumRecs()>0){
+        run->AddPage(pushPage);
+    }
+    else{
+        delete pushPage;
+    }
     delete myTree;myTree=NULL;
 }
 
@@ -97,15 +340,75 @@ BigQ :: BigQ (Pipe &in, Pipe &out, OrderMaker &sortorder, int runlen) {
     myThreadData.out = &out;
     myThreadData.sortorder = &sortorder;
     myThreadData.runlen = runlen;
+    Start();
+}
+
+BigQ :: BigQ (Pipe &in, Pipe &out, OrderMaker &sortorder, int runlen, SortOptions &options) {
+    myThreadData.in = &in;
+    myThreadData.out = &out;
+    myThreadData.sortorder = &sortorder;
+    myThreadData.runlen = runlen;
+    myThreadData.options = options;
+    Start();
+}
+
+void BigQ :: Start() {
     myTree=NULL;
+    myFolder=NULL;
+    heldBytes=0;
+    joined=false;
+    inputBatch = new Record[BIGQ_INPUT_BATCH];
+    inputCount=0;
+    inputPosition=0;
+    SortOptions &options = myThreadData.options;
+    if(options.mode == Aggregate){
+        // partial aggregates carry the running sum as attribute 0
+        myPartialOrder.numAtts = myThreadData.sortorder->numAtts;
+        for(int i = 0; i < myPartialOrder.numAtts; i++){
+            myPartialOrder.whichAtts[i] = myThreadData.sortorder->whichAtts[i]+1;
+            myPartialOrder.whichTypes[i] = myThreadData.sortorder->whichTypes[i];
+        }
+        myThreadData.sortorder = &myPartialOrder;
+    }
+    if(options.mode != SortAll && options.limit == 0){
+        myFolder = new RecordFolder(myThreadData.sortorder,options.mode,options.aggregate,&myStats.comparisons);
+    }
     this->f_path = Utilities::newRandomFileName(".xbin");
+    this->mySpillFile = new SpillFile(myThreadData.options.compressRuns);
     pthread_create(&myThread, NULL, BigQ::Driver,this);
     //pthread_join(myThread, NULL);
     //out.ShutDown ();
 }
 
+void BigQ :: WaitUntilDone () {
+    if(!joined){
+        pthread_join(myThread, NULL);
+        joined=true;
+    }
+}
+
+BigQStats BigQ :: GetStats () {
+    WaitUntilDone();
+    return myStats;
+}
+
+void BigQ :: PrintStats (BigQStats &stats) {
+    cout << "Records In : " << stats.recordsIn << ", Records Out : " << stats.recordsOut << endl;
+    cout << "Runs : " << stats.runs << ", Average Run Length : " << stats.averageRunLength << " pages" << endl;
+    double ratio = stats.spillBytesWritten > 0 ? (double) stats.spillBytesRaw / stats.spillBytesWritten : 0;
+    cout << "Spill Bytes Raw : " << stats.spillBytesRaw << ", Written : " << stats.spillBytesWritten
+         << " (ratio " << ratio << "), Read : " << stats.spillBytesRead << endl;
+    cout << "Merge Fan-In : " << stats.mergeFanIn << ", Merge Passes : " << stats.mergePasses << endl;
+    cout << "Comparisons : " << stats.comparisons << endl;
+    cout << "Phase 1 : " << stats.phase1Seconds << " s, Phase 2 : " << stats.phase2Seconds
+         << " s (codec " << stats.codecSeconds << " s, I/O " << stats.ioSeconds << " s)" << endl;
+}
+
 // destructor
 BigQ::~BigQ () {
+    delete mySpillFile;
+    delete myFolder;
+    delete [] inputBatch;
     if(Utilities::checkfileExist(f_path)) {
         if( remove(f_path) != 0 )
         cerr<< "Error deleting file" ;
@@ -137,9 +440,18 @@ void run::getPages(vector<Page*> * myPageVector) {
     myPageVector->swap(this->pages);
 }
 bool run::checkRunFull() {
-    return this->pages.size() == this->runLength;
+    return this->pages.size() >= this->runLength;
+}
+void run::setRunLength(int runLength) {
+    this->runLength = runLength;
+}
+int run::getRunLength() {
+    return this->runLength;
 }
-bool run::clearPages() {
+void run::clearPages() {
+    for(vector<Page*>::iterator i = pages.begin() ; i!=pages.end() ; ++i){
+        delete *(i);
+    }
     this->pages.clear();
 }
 int run::getRunSize() {
@@ -148,26 +460,15 @@ int run::getRunSize() {
 int run::addRecordAtPage(long long int pageCount, Record *rec) {
     return this->pages.at(pageCount)->Append(rec);
 }
-int run::writeRunToFile(File *file) {
-    int writeLocation=0;
-    if(!Utilities::checkfileExist(f_path)) {
-        file->Open(0,f_path);
-    }
-    else{
-        file->Open(1,f_path);
-        writeLocation=file->GetLength()-1;
-    }
+int run::writeRunToFile(SpillFile *file) {
     int loopend = pages.size()>runLength ? runLength:pages.size();
     bool difference = false;
     for(int i=0;i<loopend;i++) {
-        Record tempRecord;
-        Page tempPage;
-        while(pages.at(i)->GetFirst(&tempRecord)) {
-            tempPage.Append(&tempRecord);
-        }
         //write this page to file
-        file->AddPage(&tempPage,writeLocation);writeLocation++;
+        file->AddPage(pages.at(i));
+        pages.at(i)->EmptyItOut();
     }
+    file->EndRun();
     if(pages.size()>runLength){
         Page *lastPage = new Page();
         Record temp;
@@ -178,15 +479,14 @@ int run::writeRunToFile(File *file) {
         this->AddPage(lastPage);
         difference=true;
     }
-    file->Close();
     return difference;
 }
 // ------------------------------------------------------------------
 
 // ------------------------------------------------------------------
-TournamentTree :: TournamentTree(run * run,OrderMaker * sortorder){
+TournamentTree :: TournamentTree(run * run,OrderMaker * sortorder,long long * comparisons){
     myOrderMaker = sortorder;
-    myQueue = new priority_queue<QueueObject,vector<QueueObject>,CustomComparator>(CustomComparator(sortorder));
+    myQueue = new priority_queue<QueueObject,vector<QueueObject>,CustomComparator>(CustomComparator(sortorder,comparisons));
     isRunManagerAvailable = false;
     run->getPages(&myPageVector);
     InititateForRun();
@@ -244,10 +544,10 @@ void TournamentTree :: RefillOutputBufferForRun(){
 }
 
 
-TournamentTree :: TournamentTree(RunManager * manager,OrderMaker * sortorder){
+TournamentTree :: TournamentTree(RunManager * manager,OrderMaker * sortorder,long long * comparisons){
     myOrderMaker = sortorder;
     myRunManager = manager;
-    myQueue = new priority_queue<QueueObject,vector<QueueObject>,CustomComparator>(CustomComparator(sortorder));
+    myQueue = new priority_queue<QueueObject,vector<QueueObject>,CustomComparator>(CustomComparator(sortorder,comparisons));
     isRunManagerAvailable = true;
     myRunManager->getPages(&myPageVector);
     Inititate();
@@ -327,30 +627,40 @@ bool TournamentTree :: GetSortedPage(Page ** page){
     }
     return 0;
 }
+
+TournamentTree :: ~TournamentTree(){
+    for(vector<Page*>::iterator i = myPageVector.begin() ; i!=myPageVector.end() ; ++i){
+        delete *(i);
+    }
+    delete myQueue;
+}
 // ------------------------------------------------------------------
 
 
 // ------------------------------------------------------------------
-RunManager :: RunManager(int runLength,char * f_path){
+RunManager :: RunManager(int runLength,SpillFile * file){
     this->runLength = runLength;
-    this->f_path = f_path;
-    this->file.Open(1,this->f_path);
-    int totalPages = file.GetLength()-1;
-    this->noOfRuns = totalPages/runLength + (totalPages % runLength != 0);
-    this->totalPages = totalPages;
-    int pageOffset = 0;
+    Init(file,0,file->GetNoOfRuns());
+}
+
+RunManager :: RunManager(SpillFile * file,int firstRun,int noOfRuns){
+    this->runLength = 0;
+    Init(file,firstRun,noOfRuns);
+}
+
+void RunManager :: Init(SpillFile * file,int firstRun,int noOfRuns){
+    this->file = file;
+    this->totalPages = file->GetLength();
+    this->noOfRuns = noOfRuns;
+    // runs may be shorter than runLength, so take their bounds from the spill file
     for(int i = 0; i<noOfRuns;i++){
         RunFileObject fileObject;
+        off_t startPage, endPage;
+        file->GetRunBounds(firstRun+i,&startPage,&endPage);
         fileObject.runId = i;
-        fileObject.startPage = pageOffset;
+        fileObject.startPage = startPage;
         fileObject.currentPage = fileObject.startPage;
-        pageOffset+=runLength;
-        if (pageOffset <=totalPages){
-            fileObject.endPage = pageOffset-1;
-        }
-        else{
-            fileObject.endPage =  fileObject.startPage + (totalPages-fileObject.startPage-1);
-        }
+        fileObject.endPage = endPage;
         runLocation.insert(make_pair(i,fileObject));
     }
 
@@ -362,7 +672,7 @@ void  RunManager:: getPages(vector<Page*> * myPageVector){
         unordered_map<int,RunFileObject>::iterator runGetter = runLocation.find(i);
         if(!(runGetter == runLocation.end())){
             Page * pagePtr = new Page();
-            this->file.GetPage(pagePtr,runGetter->second.currentPage);
+            this->file->GetPage(pagePtr,runGetter->second.currentPage);
             runGetter->second.currentPage+=1;
             if(runGetter->second.currentPage>runGetter->second.endPage){
                 runLocation.erase(i);
@@ -375,7 +685,7 @@ void  RunManager:: getPages(vector<Page*> * myPageVector){
 bool RunManager :: getNextPageOfRun(Page * page,int runNo){
     unordered_map<int,RunFileObject>::iterator runGetter = runLocation.find(runNo);
     if(!(runGetter == runLocation.end())){
-        this->file.GetPage(page,runGetter->second.currentPage);
+        this->file->GetPage(page,runGetter->second.currentPage);
         runGetter->second.currentPage+=1;
         if(runGetter->second.currentPage>runGetter->second.endPage){
             runLocation.erase(runNo);
@@ -385,7 +695,6 @@ bool RunManager :: getNextPageOfRun(Page * page,int runNo){
     return false;
 }
 RunManager :: ~RunManager(){
-    file.Close();
 }
 
 int RunManager :: getNoOfRuns()
@@ -408,15 +717,238 @@ int RunManager :: getTotalPages()
 
 
 // ------------------------------------------------------------------
-CustomComparator :: CustomComparator(OrderMaker * sortorder){
+SpillFile :: SpillFile(bool compress){
+    this->compress = compress;
+    this->myFilDes = -1;
+    this->writeOffset = 0;
+    this->totalPages = 0;
+    this->pageBits = NULL;
+    this->codecBits = NULL;
+    this->rawBytes = 0;
+    this->storedBytes = 0;
+    this->readBytes = 0;
+    this->codecSeconds = 0;
+    this->ioSeconds = 0;
+}
+
+SpillFile :: ~SpillFile(){
+    delete [] pageBits;
+    delete [] codecBits;
+}
+
+void SpillFile :: Open(char * f_path){
+    if(!compress){
+        rawFile.Open(0,f_path);
+        return;
+    }
+    myFilDes = open(f_path, O_TRUNC | O_RDWR | O_CREAT, S_IRUSR | S_IWUSR);
+    if (myFilDes < 0) {
+        cerr << "BAD!  Open did not work for " << f_path << "\n";
+        exit (1);
+    }
+    pageBits = new char[PAGE_SIZE];
+    codecBits = new char[PageCodec::MaxCompressedLength(PAGE_SIZE)];
+}
+
+void SpillFile :: AddPage(Page * page){
+    int pageSize = page->getCurSizeInBytes();
+    rawBytes += pageSize;
+    if(!compress){
+        chrono::steady_clock::time_point ioStart = chrono::steady_clock::now();
+        rawFile.AddPage(page,totalPages);
+        ioSeconds += SecondsSince(ioStart);
+        storedBytes += PAGE_SIZE;
+        totalPages++;
+        return;
+    }
+    chrono::steady_clock::time_point codecStart = chrono::steady_clock::now();
+    page->ToBinary(pageBits);
+    int compressedSize = PageCodec::Compress(pageBits,pageSize,codecBits);
+    codecSeconds += SecondsSince(codecStart);
+
+    chrono::steady_clock::time_point ioStart = chrono::steady_clock::now();
+    pwrite(myFilDes,codecBits,compressedSize,writeOffset);
+    ioSeconds += SecondsSince(ioStart);
+
+    pageOffsets.push_back(writeOffset);
+    pageSizes.push_back(compressedSize);
+    writeOffset += compressedSize;
+    storedBytes += compressedSize;
+    totalPages++;
+}
+
+void SpillFile :: GetPage(Page * page, off_t whichPage){
+    if(!compress){
+        chrono::steady_clock::time_point ioStart = chrono::steady_clock::now();
+        rawFile.GetPage(page,whichPage);
+        ioSeconds += SecondsSince(ioStart);
+        readBytes += PAGE_SIZE;
+        return;
+    }
+    if (whichPage >= totalPages) {
+        cerr << "BAD: you tried to read past the end of the spill file\n";
+        exit (1);
+    }
+    chrono::steady_clock::time_point ioStart = chrono::steady_clock::now();
+    pread(myFilDes,codecBits,pageSizes[whichPage],pageOffsets[whichPage]);
+    ioSeconds += SecondsSince(ioStart);
+    readBytes += pageSizes[whichPage];
+
+    chrono::steady_clock::time_point codecStart = chrono::steady_clock::now();
+    if(PageCodec::Decompress(codecBits,pageSizes[whichPage],pageBits,PAGE_SIZE) < 0){
+        cerr << "BAD: spill file page " << whichPage << " is corrupt\n";
+        exit (1);
+    }
+    page->FromBinary(pageBits);
+    codecSeconds += SecondsSince(codecStart);
+}
+
+void SpillFile :: EndRun(){
+    // empty runs are not recorded
+    if(totalPages > (runEnds.empty() ? 0 : runEnds.back())){
+        runEnds.push_back(totalPages);
+    }
+}
+
+int SpillFile :: GetNoOfRuns(){
+    return runEnds.size();
+}
+
+void SpillFile :: GetRunBounds(int runId, off_t * startPage, off_t * endPage){
+    *startPage = runId == 0 ? 0 : runEnds.at(runId-1);
+    *endPage = runEnds.at(runId)-1;
+}
+
+off_t SpillFile :: GetLength(){
+    return totalPages;
+}
+
+bool SpillFile :: IsCompressed(){
+    return compress;
+}
+
+void SpillFile :: Close(){
+    if(!compress){
+        rawFile.Close();
+    }
+    else if(myFilDes >= 0){
+        close(myFilDes);
+        myFilDes = -1;
+    }
+}
+
+// ------------------------------------------------------------------
+
+
+// ------------------------------------------------------------------
+RecordFolder :: RecordFolder(OrderMaker * sortorder, SortMode mode, Function * aggregate, long long * comparisons){
+    this->myOrderMaker = sortorder;
+    this->comparisons = comparisons;
+    this->mode = mode;
+    this->aggregate = aggregate;
+    this->hasPending = false;
+}
+
+void RecordFolder :: Prepare(Record * rec){
+    if(mode != Aggregate){
+        return;
+    }
+    int intResult = 0;
+    double doubleResult = 0;
+    Type sumType = aggregate->ReturnInt() ? Int : Double;
+    aggregate->Apply(*rec,intResult,doubleResult);
+
+    // build (sum, rec); every slot of the old header is kept, shifted by the
+    // space taken by the sum, so the number of attributes need not be known
+    char * oldBits = rec->bits;
+    int oldLength = ((int *) oldBits)[0];
+    int oldDataStart = ((int *) oldBits)[1];
+    int slots = oldDataStart/sizeof(int) - 1;
+    int sumPos = sizeof(int) * (slots + 2);
+    if(sumType == Double && sumPos % sizeof(double) != 0){
+        sumPos += sizeof(int);
+    }
+    int dataStart = sumPos + (sumType == Int ? sizeof(int) : sizeof(double));
+    // keep doubles of the old record aligned
+    while((dataStart - oldDataStart) % sizeof(double) != 0){
+        dataStart += sizeof(int);
+    }
+    int shift = dataStart - oldDataStart;
+
+    char * newBits = new char[oldLength + shift];
+    memset(newBits,0,dataStart);
+    ((int *) newBits)[0] = oldLength + shift;
+    ((int *) newBits)[1] = sumPos;
+    for(int i = 1; i <= slots; i++){
+        ((int *) newBits)[i+1] = ((int *) oldBits)[i] + shift;
+    }
+    if(sumType == Int){
+        *((int *) (newBits + sumPos)) = intResult;
+    }
+    else{
+        *((double *) (newBits + sumPos)) = doubleResult;
+    }
+    memcpy(newBits + dataStart, oldBits + oldDataStart, oldLength - oldDataStart);
+    delete [] rec->bits;
+    rec->bits = newBits;
+}
+
+bool RecordFolder :: Push(Record * rec, Record * done){
+    if(!hasPending){
+        pending.Consume(rec);
+        hasPending = true;
+        return false;
+    }
+    if(comparisons != NULL){
+        (*comparisons)++;
+    }
+    if(myComparisonEngine.Compare(&pending,rec,myOrderMaker) == 0){
+        // duplicates are simply dropped, partial aggregates add up their sums
+        if(mode == Aggregate){
+            char * into = pending.bits + ((int *) pending.bits)[1];
+            char * from = rec->bits + ((int *) rec->bits)[1];
+            if(aggregate->ReturnInt()){
+                *((int *) into) += *((int *) from);
+            }
+            else{
+                *((double *) into) += *((double *) from);
+            }
+        }
+        return false;
+    }
+    done->Consume(&pending);
+    pending.Consume(rec);
+    return true;
+}
+
+bool RecordFolder :: Flush(Record * done){
+    if(!hasPending){
+        return false;
+    }
+    done->Consume(&pending);
+    hasPending = false;
+    return true;
+}
+// ------------------------------------------------------------------
+
+
+// ------------------------------------------------------------------
+CustomComparator :: CustomComparator(OrderMaker * sortorder, long long * comparisons){
     this->myOrderMaker = sortorder;
+    this->comparisons = comparisons;
 }
 bool CustomComparator :: operator ()( QueueObject lhs, QueueObject rhs){
+    if(comparisons != NULL){
+        (*comparisons)++;
+    }
     int val = myComparisonEngine.Compare(lhs.record,rhs.record,myOrderMaker);
     return (val <=0)? false : true;
 }
 
 bool CustomComparator :: operator ()( Record* lhs, Record* rhs){
+    if(comparisons != NULL){
+        (*comparisons)++;
+    }
     int val = myComparisonEngine.Compare(lhs,rhs,myOrderMaker);
     return (val <0)? true : false;
 }
@@ -11,8 +11,13 @@
 #include "Record.h"
 #include "ComparisonEngine.h"
 #include "Comparison.h"
+#include "PageCodec.h"
+#include "Function.h"
+#include "MemoryGovernor.h"
 using namespace std;
 
+// records a BigQ takes from its input pipe at once
+#define BIGQ_INPUT_BATCH 256
 
 // ------------------------------------------------------------------
 // structure to encapsulate Data for Runmanager
@@ -29,15 +34,111 @@ typedef struct{
     Record * record;
 } QueueObject;
 
+// what BigQ does with records that have equal sort keys
+typedef enum {SortAll, RemoveDuplicates, Aggregate} SortMode;
+
+// structure to encapsulate the optional behaviour of a BigQ
+typedef struct {
+    // compress every run page with PageCodec before it is spilled
+    bool compressRuns = false;
+    // only emit the first limit records of the sorted order (0 for all)
+    int limit = 0;
+    // RemoveDuplicates keeps one record per key, Aggregate emits one
+    // (sum, record) per key like GroupBy; both fold while forming runs
+    // and while merging them. Ignored when limit is set.
+    SortMode mode = SortAll;
+    // function summed over the records of a key when mode is Aggregate
+    Function * aggregate = NULL;
+    // when set, runlen only says how much memory the sort would like and the
+    // run length is negotiated with the governor at every run boundary
+    MemoryGovernor * governor = NULL;
+    int memoryId = -1;
+    // bytes of the account's share planned for this sort when the account
+    // is shared with other buffers (0 for the whole share)
+    long long memoryShare = 0;
+} SortOptions;
+
+// structure to encapsulate what a BigQ did, to compare sort configurations
+typedef struct {
+    long long recordsIn = 0;
+    long long recordsOut = 0;
+    // sorted runs written by phase 1 and their average length in pages
+    int runs = 0;
+    double averageRunLength = 0;
+    // bytes of spilled page images, and as stored on disk
+    long long spillBytesRaw = 0;
+    long long spillBytesWritten = 0;
+    long long spillBytesRead = 0;
+    // runs merged at once by the final merge and number of merge passes
+    int mergeFanIn = 0;
+    int mergePasses = 0;
+    // calls of the sort order comparison while sorting, merging and folding
+    long long comparisons = 0;
+    // wall time of each phase, and the part of it spent in the codec and I/O
+    double phase1Seconds = 0;
+    double phase2Seconds = 0;
+    double codecSeconds = 0;
+    double ioSeconds = 0;
+} BigQStats;
+
 // structure to encapsulate Data Passed to BigQ's Constructor
 typedef struct {
     Pipe * in;
     Pipe * out;
     OrderMaker * sortorder;
     int runlen;
+    SortOptions options;
 } ThreadData;
 // ------------------------------------------------------------------
 
+// ------------------------------------------------------------------
+// Class used to keep the sorted runs of a BigQ on disk. Pages are either
+// stored as they are in a File or compressed with PageCodec and packed
+// back to back, in which case the location of every page is kept in memory.
+class SpillFile {
+    bool compress;
+    // used when the pages are stored uncompressed
+    File rawFile;
+    // used when the pages are stored compressed
+    int myFilDes;
+    off_t writeOffset;
+    vector<off_t> pageOffsets;
+    vector<int> pageSizes;
+    char * pageBits;
+    char * codecBits;
+    // number of pages written so far
+    off_t totalPages;
+    // page (exclusive) at which each run written so far ends
+    vector<off_t> runEnds;
+public:
+    // bytes of page images handed to the spill file
+    long long rawBytes;
+    // bytes actually written to and read from the disk
+    long long storedBytes;
+    long long readBytes;
+    // time spent in the codec and in disk I/O
+    double codecSeconds;
+    double ioSeconds;
+
+    SpillFile(bool compress);
+    ~SpillFile();
+    //      function to create the spill file at the given path
+    void Open(char * f_path);
+    //      function to append a page at the end of the current run
+    void AddPage(Page * page);
+    //      function to read back the given page
+    void GetPage(Page * page, off_t whichPage);
+    //      function to mark the end of the current run
+    void EndRun();
+    int GetNoOfRuns();
+    //      function to get first and last page (inclusive) of a run
+    void GetRunBounds(int runId, off_t * startPage, off_t * endPage);
+    off_t GetLength();
+    bool IsCompressed();
+    void Close();
+};
+// ------------------------------------------------------------------
+
 // ------------------------------------------------------------------
 class run {
     char * f_path;
@@ -54,8 +155,11 @@ class run {
         int addRecordAtPage(long long int pageCount, Record *rec);
         //      function to check if the run if full.
         bool checkRunFull();
+        //      function to change the run length between two runs.
+        void setRunLength(int runLength);
+        int getRunLength();
         //      function to empty the if the run if full.
-        bool clearPages();
+        void clearPages();
         //      function to get runSize.
         int getRunSize();
         vector<Page*> getPages();
@@ -63,7 +167,7 @@ class run {
         void getPages(vector<Page*> * pagevector);
         bool customRecordComparator(Record &left, Record &right);
         //      function to writeRun to File after Sorting.
-        int writeRunToFile(File *file);
+        int writeRunToFile(SpillFile *file);
 };
 // ------------------------------------------------------------------
 
@@ -73,8 +177,10 @@ class run {
 class CustomComparator{
     ComparisonEngine myComparisonEngine;
     OrderMaker * myOrderMaker;
+    // incremented on every comparison when not NULL
+    long long * comparisons;
 public:
-    CustomComparator(OrderMaker * sortorder);
+    CustomComparator(OrderMaker * sortorder, long long * comparisons = NULL);
     //  Custom Funtion for sorting vector of records
     bool operator()( Record* lhs,   Record* rhs);
     //  Custom Funtion for sorting in priority queue.
@@ -88,11 +194,13 @@ class RunManager{
     int noOfRuns;
     int runLength;
     int totalPages;
-    File file;
-    char * f_path;
+    SpillFile * file;
     unordered_map<int,RunFileObject> runLocation;
+    void Init(SpillFile * file,int firstRun,int noOfRuns);
 public:
-    RunManager(int runLength,char * f_path);
+    RunManager(int runLength,SpillFile * file);
+//  Constructor to read only noOfRuns runs of the file, starting at firstRun
+    RunManager(SpillFile * file,int firstRun,int noOfRuns);
 //  Function to get Inital Set of Pages
     void getPages(vector<Page*> * myPageVector);
 //  Function to get Next Page for a particular Run
@@ -121,8 +229,9 @@ class TournamentTree{
 //  Function to initiate and process the queue with records pulled from run
     void InititateForRun();
 public:
-    TournamentTree(run * run,OrderMaker * sortorder);
-    TournamentTree(RunManager * manager,OrderMaker * sortorder);
+    TournamentTree(run * run,OrderMaker * sortorder,long long * comparisons = NULL);
+    TournamentTree(RunManager * manager,OrderMaker * sortorder,long long * comparisons = NULL);
+    ~TournamentTree();
 //  Function to refill output buffer using RunManger.
     void RefillOutputBuffer();
 //  Function to get sorted output buffer and refill buffer again
@@ -134,6 +243,29 @@ public:
 };
 // ------------------------------------------------------------------
 
+// ------------------------------------------------------------------
+// Class used to fold consecutive records with equal keys of a sorted stream.
+// In Aggregate mode records are first turned into partial aggregates: the
+// function value is prepended as attribute 0 and summed when records fold.
+class RecordFolder{
+    ComparisonEngine myComparisonEngine;
+    OrderMaker * myOrderMaker;
+    SortMode mode;
+    Function * aggregate;
+    Record pending;
+    bool hasPending;
+    long long * comparisons;
+public:
+    RecordFolder(OrderMaker * sortorder, SortMode mode, Function * aggregate, long long * comparisons = NULL);
+//  Function to turn an input record into a partial aggregate (Aggregate mode only)
+    void Prepare(Record * rec);
+//  Function to add the next sorted record; returns true when a finished record was put in done
+    bool Push(Record * rec, Record * done);
+//  Function to get the last pending record at the end of the stream
+    bool Flush(Record * done);
+};
+// ------------------------------------------------------------------
+
 // ------------------------------------------------------------------
 // Class used to sort the heap binary files.
 class BigQ {
@@ -141,10 +273,33 @@ class BigQ {
      TournamentTree * myTree;
      pthread_t myThread;
      int totalRuns;
-     File myFile;
+     SpillFile * mySpillFile;
+     RecordFolder * myFolder;
+     // sort order over partial aggregates, used in Aggregate mode
+     OrderMaker myPartialOrder;
      char * f_path;
+     // bytes currently held from the memory governor
+     long long heldBytes;
+     BigQStats myStats;
+     bool joined;
+     // records taken from the input pipe and not yet handed to the sort
+     Record * inputBatch;
+     int inputCount;
+     int inputPosition;
+//   function to get the bytes of the governor's budget planned for this sort
+     long long GetShare();
+//   function to get the next input record, taking them from the pipe a batch at a time
+     int RemoveInput(Record * rec);
+//   function to create the spill file and start the sorting thread
+     void Start();
+//   function to keep the first limit records in a bounded heap instead of sorting all
+     void TopK();
+//   function to swap the memory held for the given number of bytes, returns the pages granted
+     int NegotiateMemory(long long bytes, long long minimum);
 //   function to implement phase1 of TPMMS algorithm
      void Phase1();
+//   function to merge groups of fanIn runs when they can not all be merged at once
+     void MergePass(int fanIn);
 //   function to implement phase2 of TPMMS algorithm
      void Phase2();
 
@@ -154,6 +309,13 @@ public:
      static void* Driver(void*);
     //   constructor
      BigQ (Pipe &in, Pipe &out, OrderMaker &sortorder, int runlen);
+     BigQ (Pipe &in, Pipe &out, OrderMaker &sortorder, int runlen, SortOptions &options);
+    //   function to wait for the sorting thread, the output pipe must be drained first
+     void WaitUntilDone ();
+    //   function to get the statistics of the sort, waits for it to finish
+     BigQStats GetStats ();
+    //   function to print statistics of a sort
+     static void PrintStats (BigQStats &stats);
     //   destructor
      ~BigQ ();
 };
@@ -120,6 +120,31 @@ int OrderMaker::getNumAtts() {
 	return numAtts;
 }
 
+unsigned long OrderMaker :: Hash (Record *rec) {
+	// FNV-1a over the bytes of the attributes
+	unsigned long hash = 14695981039346656037UL;
+	char *bits = rec->bits;
+	for (int i = 0; i < numAtts; i++) {
+		char *value = bits + ((int *) bits)[whichAtts[i] + 1];
+		int length;
+		if (whichTypes[i] == Int) {
+			length = sizeof (int);
+		} else if (whichTypes[i] == Double) {
+			length = sizeof (double);
+		} else {
+			length = strlen (value);
+		}
+		for (int j = 0; j < length; j++) {
+			hash ^= (unsigned char) value[j];
+			hash *= 1099511628211UL;
+		}
+		// separate the attributes, so that ("ab","c") and ("a","bc") differ
+		hash ^= 0xff;
+		hash *= 1099511628211UL;
+	}
+	return hash;
+}
+
 void OrderMaker::growFromParseTree (NameList* gAtts, Schema* inputSchema) {
     
     for(; gAtts; gAtts = gAtts->next, numAtts++) {
@@ -683,6 +708,84 @@ int CNF::GetSortOrdersCopy(OrderMaker& left, OrderMaker& right)
         return left.numAtts;
 }
 
+int CNF::GetRangeOrderMakers(OrderMaker &sortOrder, OrderMaker &lower, OrderMaker &upper){
+    lower.numAtts = 0;
+    upper.numAtts = 0;
+    for (int i = 0; i < sortOrder.numAtts; i++)
+    {
+        // literals compared with this attribute, -1 if there is none
+        int equal = -1, greater = -1, less = -1;
+        for (int j = 0; j < numAnds; j++)
+        {
+            // a disjunction does not bound the attribute
+            if (orLens[j] != 1 || orList[j][0].attType != sortOrder.whichTypes[i]) {
+                continue;
+            }
+            Comparison &c = orList[j][0];
+            CompOperator op = c.op;
+            int whichLiteral;
+            if (c.operand1 == Left && c.whichAtt1 == sortOrder.whichAtts[i] && c.operand2 == Literal) {
+                whichLiteral = c.whichAtt2;
+            }
+            // literal on the left, (5 < a) bounds a the same way as (a > 5)
+            else if (c.operand2 == Left && c.whichAtt2 == sortOrder.whichAtts[i] && c.operand1 == Literal) {
+                whichLiteral = c.whichAtt1;
+                if (op == LessThan) {
+                    op = GreaterThan;
+                } else if (op == GreaterThan) {
+                    op = LessThan;
+                }
+            }
+            else {
+                continue;
+            }
+            if (op == Equals && equal < 0) {
+                equal = whichLiteral;
+            } else if (op == GreaterThan && greater < 0) {
+                greater = whichLiteral;
+            } else if (op == LessThan && less < 0) {
+                less = whichLiteral;
+            }
+        }
+        if (equal >= 0) {
+            lower.whichAtts[lower.numAtts] = equal;
+            lower.whichTypes[lower.numAtts] = sortOrder.whichTypes[i];
+            lower.numAtts++;
+            upper.whichAtts[upper.numAtts] = equal;
+            upper.whichTypes[upper.numAtts] = sortOrder.whichTypes[i];
+            upper.numAtts++;
+            continue;
+        }
+        // a range ends the prefix, the attributes after it are not ordered within it
+        if (greater >= 0) {
+            lower.whichAtts[lower.numAtts] = greater;
+            lower.whichTypes[lower.numAtts] = sortOrder.whichTypes[i];
+            lower.numAtts++;
+        }
+        if (less >= 0) {
+            upper.whichAtts[upper.numAtts] = less;
+            upper.whichTypes[upper.numAtts] = sortOrder.whichTypes[i];
+            upper.numAtts++;
+        }
+        break;
+    }
+    return lower.numAtts > 0 || upper.numAtts > 0;
+}
+
+void CNF::GrowFromSortOrders(OrderMaker &order, OrderMaker &literalOrder){
+    numAnds = order.numAtts;
+    for (int i = 0; i < numAnds; i++)
+    {
+        orLens[i] = 1;
+        orList[i][0].operand1 = Left;
+        orList[i][0].whichAtt1 = order.whichAtts[i];
+        orList[i][0].operand2 = Literal;
+        orList[i][0].whichAtt2 = literalOrder.whichAtts[i];
+        orList[i][0].attType = order.whichTypes[i];
+        orList[i][0].op = Equals;
+    }
+}
+
 OrderMaker* CNF::GetQueryOrderMaker(OrderMaker &sortOrderMaker){
 
     OrderMaker cnfOrderMaker;
@@ -36,6 +36,7 @@ public:
 
 
 class Schema;
+class Record;
 
 // This structure encapsulates a sort order for records
 class  OrderMaker {
@@ -63,6 +64,11 @@ public:
 
 	// get number of attributes
 	int getNumAtts();
+
+	// hashes the attributes of the record in this order; records (and
+	// literals) with equal values hash alike, even in another OrderMaker
+	// over attributes of the same types
+	unsigned long Hash (Record *rec);
     
     void growFromParseTree(NameList* gAtts, Schema* inputSchema);
 
@@ -109,6 +115,20 @@ public:
     
     OrderMaker* GetQueryOrderMaker(OrderMaker &srtorder);
 
+    // builds the bounds a file sorted on sortOrder can seek to and stop at.
+    // Both cover a prefix of the sort order: the attributes compared for
+    // equality, then one attribute compared with > (lower) or < (upper).
+    // whichAtts index the literal record, so the bounds are used as
+    // Compare(&literal, &lower, &rec, &sortOrder). Returns 0 if there is
+    // neither bound.
+    int GetRangeOrderMakers(OrderMaker &sortOrder, OrderMaker &lower, OrderMaker &upper);
+
+    // builds a CNF over the records of a single relation that asks every
+    // attribute of order to equal the attribute at the same position of
+    // literalOrder in the literal record. With the sort orders of a join,
+    // a left record is the literal selecting the right records it joins with
+    void GrowFromSortOrders (OrderMaker &order, OrderMaker &literalOrder);
+
 
 };
 
@@ -1,11 +1,12 @@
 #include "DBFile.h"
 #include "Utilities.h"
+#include <algorithm>
 
 /*-----------------------------------------------------------------------------------*/
 //                   GENERIC DBFILE CLASS FUNCTION DEFINATION
 /*-----------------------------------------------------------------------------------*/
 GenericDBFile::GenericDBFile(){
-    
+    hasPageOverflow = false;
 }
 
 GenericDBFile::~GenericDBFile(){
@@ -35,9 +36,10 @@ int GenericDBFile::GetPageLocationToReWrite(){
 void GenericDBFile::Create(char * f_path,fType f_type, void *startup){
     // opening file with given file extension
     myFile.Open(0,(char *)f_path);
-    if (startup!=NULL and f_type==sorted){
+    if (startup!=NULL and (f_type==sorted or f_type==tree or f_type==hashed)){
         myPreferencePtr->orderMaker = ((SortedStartUp *)startup)->o;
         myPreferencePtr->runLength  = ((SortedStartUp *)startup)->l;
+        myPreferencePtr->compactionPolicy = ((SortedStartUp *)startup)->policy;
     }
 }
 
@@ -66,50 +68,372 @@ void GenericDBFile::MoveFirst () {}
 
 void GenericDBFile::Add(Record &addme){}
 
+void GenericDBFile::AddBatch(Record *addme, int numRecords){
+    for (int i = 0; i < numRecords; i++){
+        Add(addme[i]);
+    }
+}
+
+void GenericDBFile::AddBatch(Page &addme){
+    Record rec;
+    while (addme.GetFirst(&rec)){
+        Add(rec);
+    }
+}
+
 void GenericDBFile::Load(Schema &myschema, const char *loadpath){}
 
 int GenericDBFile::GetNext(Record &fetchme){}
 
 int GenericDBFile::GetNext(Record &fetchme, CNF &cnf, Record &literal){}
 
+int GenericDBFile::GetNextPage(Page &fetchme){
+    fetchme.EmptyItOut();
+    if (hasPageOverflow){
+        fetchme.Append(&pageOverflow);
+        hasPageOverflow = false;
+    }
+    Record rec;
+    while (GetNext(rec)){
+        if (!fetchme.Append(&rec)){
+            pageOverflow.Consume(&rec);
+            hasPageOverflow = true;
+            break;
+        }
+    }
+    return fetchme.getNumRecs() > 0;
+}
+
+int GenericDBFile::ReadNextPage(Page &fetchme){
+    // the rest of a page partly read by GetNext comes first
+    if (myPage.getNumRecs() > 0){
+        Record rec;
+        while (myPage.GetFirst(&rec)){
+            fetchme.Append(&rec);
+            myPreferencePtr->currentRecordPosition++;
+        }
+        return 1;
+    }
+    if (myPreferencePtr->currentPage+1 >= myFile.GetLength()){
+        return 0;
+    }
+    // the page is decoded straight into the caller's buffer
+    myFile.GetPage(&fetchme,GetPageLocationToRead(myPreferencePtr->pageBufferMode));
+    myPreferencePtr->currentPage++;
+    myPreferencePtr->currentRecordPosition = fetchme.getNumRecs();
+    return 1;
+}
+
+Cursor * GenericDBFile::OpenCursor(){
+    cout << "only heap and sorted files can open cursors!"<<endl;
+    return NULL;
+}
+
+File * GenericDBFile::GetPageFile(off_t &numPages){
+    numPages = 0;
+    return NULL;
+}
+
 int GenericDBFile::Close(){}
 
+int GenericDBFile::GetRecord(RecordId rid, Record &fetchme){
+    cout << "only heap files can read records by address!"<<endl;
+    return 0;
+}
+
+RecordId GenericDBFile::GetRecordId(){
+    RecordId rid = {-1, -1};
+    return rid;
+}
+
+int GenericDBFile::CreateIndex(OrderMaker &key){
+    cout << "only heap files keep secondary indexes!"<<endl;
+    return 0;
+}
+
+int GenericDBFile::GetNumIndexes(){
+    return 0;
+}
+
+void GenericDBFile::GetIndexKey(int index, OrderMaker &key){
+    key.numAtts = 0;
+}
+
+int GenericDBFile::GetSortOrder(OrderMaker &order){
+    order.numAtts = 0;
+    return 0;
+}
+
+int GenericDBFile::GetNextFromIndex(int index, Record &fetchme, CNF &cnf, Record &literal){
+    return 0;
+}
+
+/*-----------------------------------END--------------------------------------------*/
+
+
+/*-----------------------------------------------------------------------------------*/
+//                   CURSOR CLASS FUNCTION DEFINATION
+/*-----------------------------------------------------------------------------------*/
+static bool AdvanceSegmentCursor(SegmentCursor * cursor){
+    if(cursor->head == NULL){
+        cursor->head = new Record();
+    }
+    // load the next page of the segment once the current one is used up
+    while(!cursor->page->GetFirst(cursor->head)){
+        if(cursor->nextPage >= cursor->totalPages){
+            delete cursor->head;
+            cursor->head = NULL;
+            return false;
+        }
+        cursor->file->GetPage(cursor->page,cursor->nextPage);
+        cursor->nextPage++;
+    }
+    return true;
+}
+
+static SegmentCursor * OpenSegmentCursor(File * file, off_t startPage){
+    SegmentCursor * cursor = new SegmentCursor();
+    cursor->file = file;
+    cursor->page = new Page();
+    cursor->nextPage = startPage;
+    cursor->totalPages = file->GetLength() > 0 ? file->GetLength()-1 : 0;
+    cursor->head = NULL;
+    cursor->ownsFile = true;
+    AdvanceSegmentCursor(cursor);
+    return cursor;
+}
+
+static void CloseSegmentCursor(SegmentCursor * cursor){
+    delete cursor->head;
+    delete cursor->page;
+    if(cursor->ownsFile){
+        cursor->file->Close();
+        delete cursor->file;
+    }
+    delete cursor;
+}
+
+static int NextFromSegmentCursors(vector<SegmentCursor *> &cursors, Record &fetchme, OrderMaker &order, ComparisonEngine &compEng){
+    // linear scan for the smallest head, the number of segments is small
+    int smallest = -1;
+    for(int i = 0; i < cursors.size(); i++){
+        if(cursors[i]->head == NULL){
+            continue;
+        }
+        if(smallest < 0 || compEng.Compare(cursors[i]->head,cursors[smallest]->head,&order) < 0){
+            smallest = i;
+        }
+    }
+    if(smallest < 0){
+        return 0;
+    }
+    fetchme.Consume(cursors[smallest]->head);
+    AdvanceSegmentCursor(cursors[smallest]);
+    return 1;
+}
+
+Cursor::Cursor(OrderMaker * order){
+    this->order = order;
+    current = 0;
+}
+
+Cursor::~Cursor(){
+    for(int i = 0; i < cursors.size(); i++){
+        CloseSegmentCursor(cursors[i]);
+    }
+}
+
+void Cursor::AddFile(File * file, bool shared){
+    SegmentCursor * cursor = OpenSegmentCursor(file,0);
+    cursor->ownsFile = !shared;
+    cursors.push_back(cursor);
+}
+
+void Cursor::MoveFirst(){
+    for(int i = 0; i < cursors.size(); i++){
+        cursors[i]->page->EmptyItOut();
+        cursors[i]->nextPage = 0;
+        AdvanceSegmentCursor(cursors[i]);
+    }
+    current = 0;
+}
+
+int Cursor::GetNext(Record &fetchme){
+    if(order != NULL){
+        return NextFromSegmentCursors(cursors,fetchme,*order,compEng);
+    }
+    while(current < cursors.size()){
+        if(cursors[current]->head != NULL){
+            fetchme.Consume(cursors[current]->head);
+            AdvanceSegmentCursor(cursors[current]);
+            return 1;
+        }
+        current++;
+    }
+    return 0;
+}
+
+int Cursor::GetNext(Record &fetchme, CNF &cnf, Record &literal){
+    while(GetNext(fetchme)){
+        if(compEng.Compare(&fetchme,&literal,&cnf)){
+            return 1;
+        }
+    }
+    return 0;
+}
+
 /*-----------------------------------END--------------------------------------------*/
 
 
 /*-----------------------------------------------------------------------------------*/
 //                   HEAP DBFILE CLASS FUNCTION DEFINATION
 /*-----------------------------------------------------------------------------------*/
+// builds a record from the attributes of from given by fromOrder, followed by ints
+static void MakeKeyRecord(Record &from, OrderMaker &fromOrder, int *tail, int numTail, Record &keyRecord) {
+    char *bits = from.bits;
+    int numAtts = ((int *) bits)[1] / sizeof(int) - 1;
+    int numKeys = fromOrder.numAtts;
+
+    // the attributes of a record are stored one after the other
+    int dataLength = 0;
+    int starts[MAX_ANDS], lengths[MAX_ANDS];
+    for (int i = 0; i < numKeys; i++){
+        int att = fromOrder.whichAtts[i];
+        starts[i] = ((int *) bits)[att+1];
+        int end = att+1 < numAtts ? ((int *) bits)[att+2] : ((int *) bits)[0];
+        lengths[i] = end - starts[i];
+        dataLength += lengths[i];
+    }
+
+    int numNewAtts = numKeys + numTail;
+    int length = sizeof(int) * (numNewAtts + 1) + dataLength + sizeof(int) * numTail;
+    char *newBits = new char[length];
+    ((int *) newBits)[0] = length;
+    int pos = sizeof(int) * (numNewAtts + 1);
+    for (int i = 0; i < numKeys; i++){
+        ((int *) newBits)[i+1] = pos;
+        memcpy(newBits + pos, bits + starts[i], lengths[i]);
+        pos += lengths[i];
+    }
+    for (int i = 0; i < numTail; i++){
+        ((int *) newBits)[numKeys+i+1] = pos;
+        *((int *) (newBits + pos)) = tail[i];
+        pos += sizeof(int);
+    }
+    delete [] keyRecord.bits;
+    keyRecord.bits = newBits;
+}
+
 HeapDBFile :: HeapDBFile(Preference * preference){
     myPreferencePtr = preference;
+    currentId.page = -1;
+    currentId.slot = -1;
+    fetchedPage = -1;
+    indexesOpen = false;
+    indexBufferBytes = 0;
+    probeIndex = -1;
+    probeOrder = NULL;
+    doProbe = true;
 }
 
 HeapDBFile::~HeapDBFile(){
+    for (int i = 0; i < fetchedRecords.size(); i++){
+        delete fetchedRecords[i];
+    }
+    delete probeOrder;
+}
 
+string HeapDBFile::GetIndexPath(int index){
+    string fileName(myPreferencePtr->preferenceFilePath);
+    return fileName.substr(0,fileName.find_last_of('.'))+"."+to_string(index)+".idx";
 }
 
-void HeapDBFile::MoveFirst () {
-    if (myFile.IsFileOpen()){
-        if (myPreferencePtr->pageBufferMode == WRITE && myPage.getNumRecs() > 0){
-            if(!myPreferencePtr->allRecordsWritten){
-                myFile.AddPage(&myPage,GetPageLocationToReWrite());
-            }
+void HeapDBFile::OpenIndex(int index, bool create){
+    // the tree file keeps its state in the heap preference, so it gets a preference of its own in memory
+    IndexInfo &info = myPreferencePtr->indexes[index];
+    Preference * preference = new Preference();
+    preference->f_type = tree;
+    preference->pageBufferMode = IDLE;
+    preference->preferenceFilePath = NULL;
+    preference->runLength = 1;
+    preference->rootPage = info.rootPage;
+    preference->firstLeaf = info.firstLeaf;
+    // entries are sorted on the key and then on the address, so the
+    // records of a key are fetched in file order
+    preference->orderMaker = new OrderMaker();
+    preference->orderMaker->numAtts = info.key.numAtts + 2;
+    for (int i = 0; i < info.key.numAtts + 2; i++){
+        preference->orderMaker->whichAtts[i] = i;
+        preference->orderMaker->whichTypes[i] = i < info.key.numAtts ? info.key.whichTypes[i] : Int;
+    }
+    TreeDBFile * indexFile = new TreeDBFile(preference);
+    string path = GetIndexPath(index);
+    if (create){
+        indexFile->Create((char *) path.c_str(), tree, NULL);
+    }
+    else if (!indexFile->Open((char *) path.c_str())){
+        cerr << "BAD: can not open index " << path << endl;
+        exit(1);
+    }
+    indexFiles.push_back(indexFile);
+    indexPreferences.push_back(preference);
+    indexBuffer.push_back(vector<Record *>());
+}
+
+void HeapDBFile::OpenIndexes(){
+    if (indexesOpen){
+        return;
+    }
+    for (int i = 0; i < myPreferencePtr->numIndexes; i++){
+        OpenIndex(i, false);
+    }
+    indexesOpen = true;
+}
+
+void HeapDBFile::FlushIndexBuffer(){
+    for (int i = 0; i < indexFiles.size(); i++){
+        vector<Record *> &entries = indexBuffer[i];
+        stable_sort(entries.begin(), entries.end(), CustomComparator(indexPreferences[i]->orderMaker));
+        indexFiles[i]->InsertBatch(entries);
+        for (int j = 0; j < entries.size(); j++){
+            delete entries[j];
         }
-        myPage.EmptyItOut();
-        myPreferencePtr->pageBufferMode = READ;
-        myFile.MoveToFirst();
-        myPreferencePtr->currentPage = 0;
-        myPreferencePtr->currentRecordPosition = 0;
+        entries.clear();
     }
+    indexBufferBytes = 0;
 }
 
-void HeapDBFile :: Add (Record &rec) {
+void HeapDBFile::CloseIndexes(){
+    FlushIndexBuffer();
+    for (int i = 0; i < indexFiles.size(); i++){
+        myPreferencePtr->indexes[i].rootPage = indexPreferences[i]->rootPage;
+        myPreferencePtr->indexes[i].firstLeaf = indexPreferences[i]->firstLeaf;
+        indexFiles[i]->Close();
+        delete indexFiles[i];
+        delete indexPreferences[i]->orderMaker;
+        delete indexPreferences[i];
+    }
+    indexFiles.clear();
+    indexPreferences.clear();
+    indexBuffer.clear();
+    indexesOpen = false;
+}
 
-    if (!myFile.IsFileOpen()){
-        cerr << "Trying to load a file which is not open!";
-        exit(1);
+off_t HeapDBFile::GetBufferPageLocation(){
+    // the buffer either rewrites the last page of the file or becomes a new page
+    return myPreferencePtr->reWriteFlag ? GetPageLocationToReWrite() : GetPageLocationToWrite();
+}
+
+void HeapDBFile::WriteBuffer(){
+    if (myPreferencePtr->pageBufferMode == WRITE && myPage.getNumRecs() > 0 && !myPreferencePtr->allRecordsWritten){
+        myFile.AddPage(&myPage,GetBufferPageLocation());
+        // the buffer is now the last page of the file, further adds rewrite it
+        myPreferencePtr->reWriteFlag = true;
+        myPreferencePtr->allRecordsWritten = true;
     }
+}
 
+void HeapDBFile::StartWriting(){
      // Flush the page data from which you are reading and load the last page to start appending records.
      if (myPreferencePtr->pageBufferMode == READ ) {
             if( myPage.getNumRecs() > 0){
@@ -128,6 +452,55 @@ void HeapDBFile :: Add (Record &rec) {
     if(myPage.getNumRecs()>0 && myPreferencePtr->allRecordsWritten){
                     myPreferencePtr->reWriteFlag = true;
     }
+}
+
+void HeapDBFile::MakeIndexEntry(Record &rec, OrderMaker &key, RecordId rid, Record &entry){
+    int address[2] = {(int) rid.page, rid.slot};
+    MakeKeyRecord(rec, key, address, 2, entry);
+}
+
+RecordId HeapDBFile::GetEntryId(Record &entry, int numKeys){
+    char *bits = entry.bits;
+    RecordId rid;
+    rid.page = *((int *) (bits + ((int *) bits)[numKeys+1]));
+    rid.slot = *((int *) (bits + ((int *) bits)[numKeys+2]));
+    return rid;
+}
+
+void HeapDBFile::MoveFirst () {
+    if (myFile.IsFileOpen()){
+        if (myPreferencePtr->pageBufferMode == WRITE && myPage.getNumRecs() > 0){
+            if(!myPreferencePtr->allRecordsWritten){
+                myFile.AddPage(&myPage,GetBufferPageLocation());
+            }
+        }
+        myPage.EmptyItOut();
+        myPreferencePtr->pageBufferMode = READ;
+        myFile.MoveToFirst();
+        myPreferencePtr->currentPage = 0;
+        myPreferencePtr->currentRecordPosition = 0;
+        for (int i = 0; i < indexFiles.size(); i++){
+            indexFiles[i]->MoveFirst();
+        }
+        doProbe = true;
+    }
+}
+
+void HeapDBFile :: Add (Record &rec) {
+
+    if (!myFile.IsFileOpen()){
+        cerr << "Trying to load a file which is not open!";
+        exit(1);
+    }
+
+    // the page consumes the record, so the indexes are built from a copy
+    Record indexed;
+    if (myPreferencePtr->numIndexes > 0){
+        OpenIndexes();
+        indexed.Copy(&rec);
+    }
+
+    StartWriting();
 
     // add record to current page
     // check if the page is full
@@ -151,6 +524,83 @@ void HeapDBFile :: Add (Record &rec) {
         this->myPage.Append(&rec);
     }
     myPreferencePtr->allRecordsWritten=false;
+    fetchedPage = -1;
+
+    currentId.page = GetBufferPageLocation();
+    currentId.slot = myPage.getNumRecs() - 1;
+    for (int i = 0; i < indexFiles.size(); i++){
+        Record *entry = new Record();
+        MakeIndexEntry(indexed, myPreferencePtr->indexes[i].key, currentId, *entry);
+        indexBufferBytes += ((int *) entry->bits)[0];
+        indexBuffer[i].push_back(entry);
+    }
+    if (indexBufferBytes >= INDEX_BUFFER_BYTES){
+        FlushIndexBuffer();
+    }
+}
+
+void HeapDBFile :: AddBatch (Record *addme, int numRecords) {
+
+    // every index entry needs the address of its record, which Add keeps
+    if (myPreferencePtr->numIndexes > 0){
+        GenericDBFile::AddBatch(addme, numRecords);
+        return;
+    }
+    if (!myFile.IsFileOpen()){
+        cerr << "Trying to load a file which is not open!";
+        exit(1);
+    }
+    if (numRecords <= 0){
+        return;
+    }
+
+    StartWriting();
+    for (int i = 0; i < numRecords; i++){
+        if (!myPage.Append(&addme[i])){
+            // write the full page where Add would and start the next one
+            myFile.AddPage(&myPage,GetBufferPageLocation());
+            myPreferencePtr->reWriteFlag = false;
+            myPage.EmptyItOut();
+            myPage.Append(&addme[i]);
+        }
+    }
+    myPreferencePtr->allRecordsWritten=false;
+    fetchedPage = -1;
+
+    currentId.page = GetBufferPageLocation();
+    currentId.slot = myPage.getNumRecs() - 1;
+}
+
+void HeapDBFile :: AddBatch (Page &addme) {
+
+    if (myPreferencePtr->numIndexes > 0){
+        GenericDBFile::AddBatch(addme);
+        return;
+    }
+    if (!myFile.IsFileOpen()){
+        cerr << "Trying to load a file which is not open!";
+        exit(1);
+    }
+    if (addme.getNumRecs() == 0){
+        return;
+    }
+
+    // the records already buffered keep their place before the page
+    StartWriting();
+    WriteBuffer();
+    off_t location = GetPageLocationToWrite();
+    myFile.AddPage(&addme,location);
+
+    // the page is now the last one of the file, the next add starts a new page
+    currentId.page = location;
+    currentId.slot = addme.getNumRecs() - 1;
+    addme.EmptyItOut();
+    myPage.EmptyItOut();
+    myPreferencePtr->reWriteFlag = false;
+    myPreferencePtr->allRecordsWritten = true;
+    myPreferencePtr->currentPage = myFile.GetLength();
+    myPreferencePtr->currentRecordPosition = 0;
+    fetchedPage = -1;
 }
 
 void HeapDBFile :: Load (Schema &f_schema, const char *loadpath) {
@@ -187,7 +637,7 @@ int HeapDBFile :: GetNext (Record &fetchme) {
         // Flush the Page Buffer if the WRITE mode was active.
         if (myPreferencePtr->pageBufferMode == WRITE && myPage.getNumRecs() > 0){
             if(!myPreferencePtr->allRecordsWritten){
-                myFile.AddPage(&myPage,GetPageLocationToReWrite());
+                myFile.AddPage(&myPage,GetBufferPageLocation());
             }
             //  Only Write Records if new records were added.
             myPage.EmptyItOut();
@@ -196,6 +646,9 @@ int HeapDBFile :: GetNext (Record &fetchme) {
             return 0;
         }
         myPreferencePtr->pageBufferMode = READ;
+        // a scan under way goes on from where it is, a CNF no longer probes an index
+        doProbe = false;
+        probeIndex = -1;
         // loop till the page is empty and if empty load the next page to read
         if (!myPage.GetFirst(&fetchme)) {
             // check if all records are read.
@@ -212,6 +665,8 @@ int HeapDBFile :: GetNext (Record &fetchme) {
         }
         // increament counter for each read.
         myPreferencePtr->currentRecordPosition++;
+        currentId.page = myPreferencePtr->currentPage - 1;
+        currentId.slot = myPreferencePtr->currentRecordPosition - 1;
         return 1;
     }
 }
@@ -221,13 +676,43 @@ int HeapDBFile :: GetNext (Record &fetchme, CNF &cnf, Record &literal) {
         if (myPreferencePtr->pageBufferMode == WRITE && myPage.getNumRecs() > 0){
             //  Only Write Records if new records were added.
             if(!myPreferencePtr->allRecordsWritten){
-                myFile.AddPage(&myPage,GetPageLocationToReWrite());
+                myFile.AddPage(&myPage,GetBufferPageLocation());
             }
             myPage.EmptyItOut();
             myPreferencePtr->currentPage = myFile.GetLength();
             myPreferencePtr->currentRecordPosition = myPage.getNumRecs();
             return 0;
         }
+        if (doProbe){
+            // read through the index whose key has the longest prefix pinned by the CNF
+            doProbe = false;
+            delete probeOrder;
+            probeOrder = NULL;
+            probeIndex = -1;
+            OpenIndexes();
+            FlushIndexBuffer();
+            for (int i = 0; i < indexFiles.size(); i++){
+                OrderMaker * queryOrder = cnf.GetQueryOrderMaker(myPreferencePtr->indexes[i].key);
+                if (queryOrder != NULL && (probeOrder == NULL || queryOrder->numAtts > probeOrder->numAtts)){
+                    delete probeOrder;
+                    probeOrder = queryOrder;
+                    probeIndex = i;
+                }
+                else{
+                    delete queryOrder;
+                }
+            }
+        }
+        if (probeIndex >= 0){
+            Record entry;
+            while (indexFiles[probeIndex]->GetNextMatch(entry, *probeOrder, literal)){
+                currentId = GetEntryId(entry, myPreferencePtr->indexes[probeIndex].key.numAtts);
+                if (GetRecord(currentId, fetchme) && myCompEng.Compare (&fetchme, &literal, &cnf)){
+                    return 1;
+                }
+            }
+            return 0;
+        }
         bool readFlag ;
         bool compareFlag;
         // loop until all records are read or if some record maches the filter CNF
@@ -243,6 +728,44 @@ int HeapDBFile :: GetNext (Record &fetchme, CNF &cnf, Record &literal) {
 
 }
 
+int HeapDBFile :: GetNextPage (Page &fetchme) {
+    fetchme.EmptyItOut();
+    // records being added are not read back until MoveFirst
+    if (!myFile.IsFileOpen() || myPreferencePtr->pageBufferMode == WRITE){
+        return 0;
+    }
+    doProbe = false;
+    probeIndex = -1;
+    if (!ReadNextPage(fetchme)){
+        return 0;
+    }
+    currentId.page = myPreferencePtr->currentPage - 1;
+    currentId.slot = myPreferencePtr->currentRecordPosition - 1;
+    return 1;
+}
+
+Cursor * HeapDBFile :: OpenCursor () {
+    if (!myFile.IsFileOpen()){
+        cout << "trying to open a cursor on a file which is not open!"<<endl;
+        return NULL;
+    }
+    // the cursor reads the file from disk, so the records added so far are written first
+    WriteBuffer();
+    Cursor * cursor = new Cursor(NULL);
+    cursor->AddFile(&myFile,true);
+    return cursor;
+}
+
+File * HeapDBFile :: GetPageFile (off_t &numPages) {
+    numPages = 0;
+    if (!myFile.IsFileOpen()){
+        return NULL;
+    }
+    WriteBuffer();
+    numPages = myFile.GetLength() > 0 ? myFile.GetLength()-1 : 0;
+    return &myFile;
+}
+
 int HeapDBFile :: Close () {
     if (!myFile.IsFileOpen()) {
         cout << "trying to close a file which is not open!"<<endl;
@@ -269,6 +792,121 @@ int HeapDBFile :: Close () {
         }
         myFile.Close();
     }
+    CloseIndexes();
+    return 1;
+}
+
+int HeapDBFile :: GetRecord (RecordId rid, Record &fetchme) {
+    WriteBuffer();
+    if (rid.page < 0 || rid.page + 1 >= myFile.GetLength() || rid.slot < 0){
+        return 0;
+    }
+    // index probes often hit the same page again, so the last page read is kept
+    if (fetchedPage != rid.page){
+        for (int i = 0; i < fetchedRecords.size(); i++){
+            delete fetchedRecords[i];
+        }
+        fetchedRecords.clear();
+        Page page;
+        myFile.GetPage(&page, rid.page);
+        Record temp;
+        while (page.GetFirst(&temp)){
+            Record *rec = new Record();
+            rec->Consume(&temp);
+            fetchedRecords.push_back(rec);
+        }
+        fetchedPage = rid.page;
+    }
+    if (rid.slot >= fetchedRecords.size()){
+        return 0;
+    }
+    fetchme.Copy(fetchedRecords[rid.slot]);
+    return 1;
+}
+
+RecordId HeapDBFile :: GetRecordId () {
+    return currentId;
+}
+
+int HeapDBFile :: GetNumIndexes () {
+    return myPreferencePtr->numIndexes;
+}
+
+void HeapDBFile :: GetIndexKey (int index, OrderMaker &key) {
+    key = myPreferencePtr->indexes[index].key;
+}
+
+int HeapDBFile :: GetNextFromIndex (int index, Record &fetchme, CNF &cnf, Record &literal) {
+    if (index < 0 || index >= myPreferencePtr->numIndexes){
+        return 0;
+    }
+    int numKeys = myPreferencePtr->indexes[index].key.numAtts;
+    if (doProbe){
+        // the entries are read in key order, from the first one matching the CNF if it pins a key prefix
+        doProbe = false;
+        OpenIndexes();
+        FlushIndexBuffer();
+        OrderMaker keyOrder = *indexPreferences[index]->orderMaker;
+        keyOrder.numAtts = numKeys;
+        delete probeOrder;
+        probeOrder = cnf.GetQueryOrderMaker(keyOrder);
+        probeIndex = index;
+    }
+    // the entries end with the address of the record, which is projected away
+    int keyAtts[MAX_ANDS];
+    for (int i = 0; i < numKeys; i++){
+        keyAtts[i] = i;
+    }
+    Record entry;
+    while (probeOrder != NULL ? indexFiles[index]->GetNextMatch(entry, *probeOrder, literal) : indexFiles[index]->GetNext(entry)){
+        entry.Project(keyAtts, numKeys, numKeys + 2);
+        if (myCompEng.Compare (&entry, &literal, &cnf)){
+            fetchme.Consume(&entry);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int HeapDBFile :: CreateIndex (OrderMaker &key) {
+    if (!myFile.IsFileOpen()){
+        cerr << "Trying to index a file which is not open!";
+        exit(1);
+    }
+    if (myPreferencePtr->numIndexes == MAX_INDEXES){
+        cout << "a heap file keeps at most " << MAX_INDEXES << " indexes!"<<endl;
+        return 0;
+    }
+    OpenIndexes();
+    int index = myPreferencePtr->numIndexes;
+    IndexInfo &info = myPreferencePtr->indexes[index];
+    info.key = key;
+    info.rootPage = -1;
+    info.firstLeaf = -1;
+    OpenIndex(index, true);
+    myPreferencePtr->numIndexes++;
+
+    // entries of the records already in the file are sorted and the tree is built bottom up
+    WriteBuffer();
+    Pipe inputPipe(100);
+    Pipe outputPipe(100);
+    BigQ bigQ(inputPipe, outputPipe, *indexPreferences[index]->orderMaker, 1);
+    Page page;
+    Record temp;
+    for (off_t i = 0; i + 1 < myFile.GetLength(); i++){
+        myFile.GetPage(&page, i);
+        RecordId rid = {i, 0};
+        while (page.GetFirst(&temp)){
+            Record entry;
+            MakeIndexEntry(temp, key, rid, entry);
+            inputPipe.Insert(&entry);
+            rid.slot++;
+        }
+    }
+    inputPipe.ShutDown();
+    indexFiles[index]->AddSorted(outputPipe);
+    bigQ.WaitUntilDone();
+    indexFiles[index]->MoveFirst();
     return 1;
 }
 
@@ -283,20 +921,39 @@ SortedDBFile :: SortedDBFile(Preference * preference){
     inputPipePtr = NULL;
     outputPipePtr = NULL;
     bigQPtr = NULL;
-    queryOrderMaker= NULL;
     doBinarySearch=true;
+    scanOpen=false;
+    compactionRunning=false;
+    compactionStarted=false;
+    baseReplaced=false;
+    basePages=-1;
+    baseFences=NULL;
+    projectionOpen=false;
+    projectRecords=false;
+    pthread_mutex_init(&segmentMutex, NULL);
 }
 
 SortedDBFile::~SortedDBFile(){
-
+    CloseScan();
+    CloseProjectionScan();
+    WaitForCompaction();
+    delete baseFences;
+    for(map<int, FenceIndex *>::iterator i = segmentFences.begin(); i != segmentFences.end(); ++i){
+        delete i->second;
+    }
+    pthread_mutex_destroy(&segmentMutex);
 }
 
 void SortedDBFile::MoveFirst () {
+    hasPageOverflow = false;
     if (myFile.IsFileOpen()){
          // Flush the Page Buffer if the WRITE mode was active.
         if(myPreferencePtr->pageBufferMode == WRITE && !myPreferencePtr->allRecordsWritten){
-                  MergeSortedInputWithFile();
+                  FlushInputToSegment();
         }
+        CloseScan();
+        CloseProjectionScan();
+        SyncBaseFile();
         if( myPage.getNumRecs() > 0){
             myPage.EmptyItOut();
         }
@@ -308,16 +965,20 @@ void SortedDBFile::MoveFirst () {
     }
 }
 
-void SortedDBFile :: Add(Record &addme){
+void SortedDBFile :: StartWriting(){
     if (!myFile.IsFileOpen()){
         cerr << "Trying to load a file which is not open!";
         exit(1);
     }
     
+    // Flush the page data from which you are reading.
+    if (myPreferencePtr->pageBufferMode == READ && myPage.getNumRecs() > 0){
+        myPage.EmptyItOut();
+    }
     
     // assign new pipe instance for input pipe if null
     if (inputPipePtr == NULL){
-        inputPipePtr = new Pipe(10);
+        inputPipePtr = new Pipe(SORTED_INPUT_BUFFER);
     }
     if(outputPipePtr == NULL){
         outputPipePtr = new Pipe(10);
@@ -325,33 +986,39 @@ void SortedDBFile :: Add(Record &addme){
     if(bigQPtr == NULL){
         bigQPtr =  new BigQ(*(inputPipePtr), *(outputPipePtr), *(myPreferencePtr->orderMaker), myPreferencePtr->runLength);
     }
-
-    
-     // Flush the page data from which you are reading and load the last page to start appending records.
-     if (myPreferencePtr->pageBufferMode == READ ) {
-        if( myPage.getNumRecs() > 0){
-            myPage.EmptyItOut();
-        }
-        // assign new pipe instance for input pipe if null
-        if (inputPipePtr == NULL){
-            inputPipePtr = new Pipe(10);
-        }
-        if(outputPipePtr == NULL){
-            outputPipePtr = new Pipe(10);
-        }
-        if(bigQPtr == NULL){
-            bigQPtr =  new BigQ(*(inputPipePtr), *(outputPipePtr), *(myPreferencePtr->orderMaker), myPreferencePtr->runLength);
-        }
-    }
     
     // set DBFile in write mode
     myPreferencePtr->pageBufferMode = WRITE;
     
+    // set allrecords written as false
+    myPreferencePtr->allRecordsWritten=false;
+}
+
+void SortedDBFile :: Add(Record &addme){
+    StartWriting();
+    
     // add record to input pipe
     inputPipePtr->Insert(&addme);
+}
+
+void SortedDBFile :: AddBatch(Record *addme, int numRecords){
+    if (numRecords <= 0){
+        return;
+    }
+    StartWriting();
     
-    // set allrecords written as false
-    myPreferencePtr->allRecordsWritten=false;
+    // the pipe takes the whole batch under one lock
+    inputPipePtr->Insert(addme, numRecords);
+}
+
+void SortedDBFile :: AddBatch(Page &addme){
+    int numRecords = addme.getNumRecs();
+    Record * records = new Record[numRecords];
+    for (int i = 0; i < numRecords; i++){
+        addme.GetFirst(&records[i]);
+    }
+    AddBatch(records, numRecords);
+    delete [] records;
 }
 
 void SortedDBFile :: Load(Schema &myschema, const char *loadpath){
@@ -368,7 +1035,7 @@ void SortedDBFile :: Load(Schema &myschema, const char *loadpath){
               }
               // assign new pipe instance for input pipe if null
                if (inputPipePtr == NULL){
-                    inputPipePtr = new Pipe(10);
+                    inputPipePtr = new Pipe(SORTED_INPUT_BUFFER);
                }
       }
     
@@ -385,9 +1052,17 @@ int SortedDBFile :: GetNext(Record &fetchme){
     if (myFile.IsFileOpen()){
         // Flush the Page Buffer if the WRITE mode was active.
         if(myPreferencePtr->pageBufferMode == WRITE && !myPreferencePtr->allRecordsWritten){
-                   MergeSortedInputWithFile();
+                   FlushInputToSegment();
         }
         myPreferencePtr->pageBufferMode = READ;
+        // with delta segments the records come from a merge of all of them
+        if(scanOpen || HasSegments()){
+            if(!scanOpen){
+                OpenScan(NULL);
+            }
+            return NextFromSegmentCursors(scanCursors,fetchme,*myPreferencePtr->orderMaker,myCompEng);
+        }
+        SyncBaseFile();
         // loop till the page is empty and if empty load the next page to read
         if (!myPage.GetFirst(&fetchme)) {
             // check if all records are read.
@@ -413,109 +1088,58 @@ int SortedDBFile :: GetNext(Record &fetchme, CNF &cnf, Record &literal){
     if (myFile.IsFileOpen()){
         // Flush the Page Buffer if the WRITE mode was active.
         if(myPreferencePtr->pageBufferMode == WRITE && !myPreferencePtr->allRecordsWritten){
-            MergeSortedInputWithFile();
+            FlushInputToSegment();
         }
         
         // set page mode to READ
         myPreferencePtr->pageBufferMode = READ;
 
-
-        if(doBinarySearch){
-            // read the current page for simplicity.
-            off_t startPage = !myPreferencePtr->currentPage?0:myPreferencePtr->currentPage-1;
-            // loop till the current page is fully read and checked record by record. Once the current page changes or the file ends break from the loop
+        // with delta segments every segment is positioned at the lower bound and merged
+        if(scanOpen || HasSegments()){
+            if(doBinarySearch){
+                doBinarySearch = false;
+                cnf.GetRangeOrderMakers(*myPreferencePtr->orderMaker, lowerBound, upperBound);
+                if(!scanOpen){
+                    OpenScan(lowerBound.numAtts > 0 ? &literal : NULL);
+                }
+            }
             while(GetNext(fetchme)){
-                if (startPage != myPreferencePtr->currentPage-1){
-                    break;
+                // records past the upper bound can not match
+                if(upperBound.numAtts > 0 && myCompEng.Compare(&literal, &upperBound, &fetchme, myPreferencePtr->orderMaker) < 0){
+                    return 0;
                 }
                 if(myCompEng.Compare(&fetchme, &literal, &cnf)){
                     return 1;
                 }
             }
-            // has the value of the next page{
-            if(myPreferencePtr->currentPage == myFile.GetLength()-1){
-                startPage = myPreferencePtr->currentPage;
-            }
-            else{
-                startPage= (myPreferencePtr->currentPage-1);
-            }
-            
-            // fetch the queryOrderMaker using the cnf given and the sort ordermaker stored in the preference.
-            queryOrderMaker= cnf.GetQueryOrderMaker(*myPreferencePtr->orderMaker);
-
-            // if the queryOrderMaker is available do a binary search to find the first matching record which is equal to literal using queryOrderMaker.
-            if(queryOrderMaker!=NULL){
-                off_t endPage = (myFile.GetLength())-2;
-                int retstatus;
-                if(endPage > 0){
-                    retstatus = BinarySearch(fetchme,literal,startPage,endPage);
-                }
-                else{
-                    retstatus = GetNext(fetchme);
-                }
-                if(retstatus){
-                    doBinarySearch = false;
-                    if (retstatus == 1){
-                        if(myCompEng.Compare(&fetchme, &literal, &cnf))
-                            return 1;
-                    }
-
-                }
-            }
-            else
-            {
-                doBinarySearch = false;
-            }
+            return 0;
+        }
+        SyncBaseFile();
 
-            //If the first record of binary search gives a match we cannot be sure that the previous page is not a match. So go Back from the returned page from the binary search untill you find a page which doesnot match.
-            // remove page and make space for the correct page to be read in.
-            myPage.EmptyItOut();
-            int previousPage = myPreferencePtr->currentPage-1;
-            Page prevPage;
-            bool brkflag=false;
-            while(previousPage>=startPage && queryOrderMaker!=NULL)
-            {
-                myFile.GetPage(&prevPage,previousPage);
-                prevPage.GetFirst(&fetchme);
-                
-                if(myCompEng.Compare(&literal, queryOrderMaker, &fetchme, myPreferencePtr->orderMaker)==0)
-                {
-                    previousPage--;
-                }
-                else
-                {
-                    while(prevPage.GetFirst(&fetchme))
-                    {
-                        if(myCompEng.Compare (&fetchme, &literal, &cnf))
-                        {
-                            char *bits = new (std::nothrow) char[PAGE_SIZE];
-                            myPage.EmptyItOut();
-                            prevPage.ToBinary (bits);
-                            myPage.FromBinary(bits);
-                            myPreferencePtr->currentPage = previousPage+1;
-                            return 1;
-                        }
-                    }
-                    brkflag=true;
-                }
-                if(brkflag)
-                {
-                    myPreferencePtr->currentPage = previousPage+1;
-                    break;
+        if(doBinarySearch){
+            doBinarySearch = false;
+            // fetch the bounds of the search using the cnf given and the sort ordermaker stored in the preference.
+            cnf.GetRangeOrderMakers(*myPreferencePtr->orderMaker, lowerBound, upperBound);
+
+            // the fences give the page of the first candidate, so the search reads a single page.
+            // The scan only moves forward from where it is.
+            if(lowerBound.numAtts > 0){
+                pthread_mutex_lock(&segmentMutex);
+                off_t startPage = GetFences(myFile,-1)->LowerBoundPage(literal,lowerBound);
+                pthread_mutex_unlock(&segmentMutex);
+                if(startPage >= myPreferencePtr->currentPage){
+                    myPage.EmptyItOut();
+                    myPreferencePtr->currentPage = startPage;
+                    myPreferencePtr->currentRecordPosition = 0;
                 }
             }
-            //spcal case
-            if(brkflag==true)
-            {
-            }
-
         }
 
         // Doing a linear Scan from the Record from where the seach stopped.
         while (GetNext(fetchme))
         {
-            // if queryOrderMaker exists and the literal is smaller than the fetched record stop the seach as all other records are greter incase of the search.
-            if (queryOrderMaker!=NULL && myCompEng.Compare(&literal,queryOrderMaker,&fetchme, myPreferencePtr->orderMaker) < 0){
+            // if the fetched record is past the upper bound stop the seach as all other records are greter incase of the search.
+            if (upperBound.numAtts > 0 && myCompEng.Compare(&literal,&upperBound,&fetchme, myPreferencePtr->orderMaker) < 0){
                 return 0;
             }
             // if the record passes the CNF compare return.
@@ -530,146 +1154,179 @@ int SortedDBFile :: GetNext(Record &fetchme, CNF &cnf, Record &literal){
     }
 }
 
+int SortedDBFile :: GetNextPage(Page &fetchme){
+    if (!myFile.IsFileOpen()){
+        fetchme.EmptyItOut();
+        return 0;
+    }
+    // Flush the Page Buffer if the WRITE mode was active.
+    if(myPreferencePtr->pageBufferMode == WRITE && !myPreferencePtr->allRecordsWritten){
+        FlushInputToSegment();
+    }
+    myPreferencePtr->pageBufferMode = READ;
+    // with delta segments the pages are filled from the merge
+    if(scanOpen || HasSegments()){
+        return GenericDBFile::GetNextPage(fetchme);
+    }
+    SyncBaseFile();
+    fetchme.EmptyItOut();
+    return ReadNextPage(fetchme);
+}
+
+Cursor * SortedDBFile :: OpenCursor(){
+    if (!myFile.IsFileOpen()){
+        cout << "trying to open a cursor on a file which is not open!"<<endl;
+        return NULL;
+    }
+    // the records added so far are sorted into a segment first
+    if(myPreferencePtr->pageBufferMode == WRITE && !myPreferencePtr->allRecordsWritten){
+        FlushInputToSegment();
+    }
+    Cursor * cursor = new Cursor(myPreferencePtr->orderMaker);
+    // the files are opened together so that a compaction swapping in its result is not seen half way
+    pthread_mutex_lock(&segmentMutex);
+    ReopenBaseFile();
+    if(GetBasePages() > 0){
+        File * base = new File();
+        base->Open(1,(char *)GetBasePath().c_str());
+        cursor->AddFile(base,false);
+    }
+    for(int i = 0; i < myPreferencePtr->numSegments; i++){
+        string segmentPath = GetSegmentPath(myPreferencePtr->segments[i].id);
+        File * segment = new File();
+        segment->Open(1,(char *)segmentPath.c_str());
+        cursor->AddFile(segment,false);
+    }
+    pthread_mutex_unlock(&segmentMutex);
+    return cursor;
+}
+
 int SortedDBFile :: Close(){
     if (!myFile.IsFileOpen()) {
         cout << "trying to close a file which is not open!"<<endl;
         return 0;
     }
     
+    bool mergedScan = scanOpen;
+    CloseScan();
+    CloseProjectionScan();
     if(myPreferencePtr->pageBufferMode == WRITE && !myPreferencePtr->allRecordsWritten){
-            MergeSortedInputWithFile();
+            FlushInputToSegment();
             myPreferencePtr->isPageFull = false;
-            myPreferencePtr->currentPage = myFile.Close();
             myPreferencePtr->allRecordsWritten = true;
-            myPreferencePtr->currentRecordPosition = myPage.getNumRecs();
+            mergedScan = true;
     }
-    else{
-        if(myPreferencePtr->pageBufferMode == READ){
-            myPreferencePtr->currentPage--;
-        }
-        myFile.Close();
+    // the preference describes the files on disk only once the compaction is done
+    WaitForCompaction();
+    if(mergedScan || baseReplaced || myPreferencePtr->numSegments > 0){
+        // the position of a merged scan is not kept, the next reader starts from the first record
+        myPreferencePtr->pageBufferMode = IDLE;
+        myPreferencePtr->currentPage = 0;
+        myPreferencePtr->currentRecordPosition = 0;
     }
+    else if(myPreferencePtr->pageBufferMode == READ){
+        myPreferencePtr->currentPage--;
+    }
+    SyncBaseFile();
+    myFile.Close();
     return 1;
     
 }
 
-void SortedDBFile::MergeSortedInputWithFile(){
-    // setup for new file
+string SortedDBFile::GetSegmentPath(int id){
     string fileName(myPreferencePtr->preferenceFilePath);
-    string newFileName = fileName.substr(0,fileName.find_last_of('.'))+".nbin";
-    char* new_f_path = new char[newFileName.length()+1];
-    strcpy(new_f_path, newFileName.c_str());
-    
-    // open new file in which the data will be written.
-    newFile.Open(0,new_f_path);
-    Page page;
-    int newFilePageCounter = 0;
-    
+    return fileName.substr(0,fileName.find_last_of('.'))+"."+to_string(id)+".seg";
+}
+
+void SortedDBFile::OpenScan(Record * literal){
+    CloseScan();
+    if(myPage.getNumRecs() > 0){
+        myPage.EmptyItOut();
+    }
+    // the base file and the segments are opened together so that a compaction
+    // swapping in its result can not be seen half way; the scan keeps reading the
+    // files it opened even if they are replaced afterwards
+    pthread_mutex_lock(&segmentMutex);
+    // the fences of the base file must be the ones of the file opened here
+    ReopenBaseFile();
+    // the base file is the oldest data, then the segments in the order they were written
+    if(GetBasePages() > 0){
+        string basePath = GetBasePath();
+        File * base = new File();
+        base->Open(1,(char *)basePath.c_str());
+        off_t startPage = literal != NULL ? GetFences(myFile,-1)->LowerBoundPage(*literal,lowerBound) : 0;
+        scanCursors.push_back(OpenSegmentCursor(base,startPage));
+    }
+    map<int, FenceIndex *> liveFences;
+    for(int i = 0; i < myPreferencePtr->numSegments; i++){
+        int id = myPreferencePtr->segments[i].id;
+        string segmentPath = GetSegmentPath(id);
+        File * segment = new File();
+        segment->Open(1,(char *)segmentPath.c_str());
+        FenceIndex * fences = GetFences(*segment,id);
+        liveFences[id] = fences;
+        scanCursors.push_back(OpenSegmentCursor(segment,literal != NULL ? fences->LowerBoundPage(*literal,lowerBound) : 0));
+    }
+    // drop the fences of segments merged away since the last scan
+    for(map<int, FenceIndex *>::iterator i = segmentFences.begin(); i != segmentFences.end(); ++i){
+        if(liveFences.find(i->first) == liveFences.end()){
+            delete i->second;
+        }
+    }
+    segmentFences = liveFences;
+    pthread_mutex_unlock(&segmentMutex);
+    scanOpen = true;
+}
+
+void SortedDBFile::CloseScan(){
+    for(int i = 0; i < scanCursors.size(); i++){
+        CloseSegmentCursor(scanCursors[i]);
+    }
+    scanCursors.clear();
+    scanOpen = false;
+}
+
+void SortedDBFile::FlushInputToSegment(){
     // shut down input pipe;
     inputPipePtr->ShutDown();
-    
+
     // flush the read buffer
     if(myPage.getNumRecs() > 0){
         myPage.EmptyItOut();
     }
-    
-    // page counts;
-    int totalPages = myFile.GetLength()-1;
-    int currentPage = 0;
-    // set flags to initiate merge
-    bool fileReadFlag = true;
-    bool outputPipeReadFlag = true;
-    
-    
-    // merge data from file and output pipe
-    bool getNextFileRecord = true;
-    bool getNextOutputPipeRecord = true;
-    Record * fileRecordptr = NULL;
-    Record * outputPipeRecordPtr = NULL;
-    
-    // loop until data is there in either the pipe or file.
-    while(fileReadFlag || outputPipeReadFlag){
-        
-        if (getNextOutputPipeRecord){
-            outputPipeRecordPtr = new Record();
-            getNextOutputPipeRecord = false;
-            if(!outputPipePtr->Remove(outputPipeRecordPtr)){
-                outputPipeReadFlag= false;
-            }
-        }
-        
-        if (getNextFileRecord){
-            fileRecordptr=new Record();
-            getNextFileRecord = false;
-            if(!myPage.GetFirst(fileRecordptr)){
-                if(currentPage<totalPages){
-                    myFile.GetPage(&myPage,currentPage);
-                    myPage.GetFirst(fileRecordptr);
-                    currentPage++;
-                }
-                else{
-                    fileReadFlag= false;
-                }
-            }
-        }
-        
-        // select record to be written
-        Record * writeRecordPtr;
-        bool consumeFlag = false;
-        if(fileReadFlag and outputPipeReadFlag){
-            if (myCompEng.Compare(fileRecordptr,outputPipeRecordPtr,myPreferencePtr->orderMaker)<=0){
-                writeRecordPtr = fileRecordptr;
-                fileRecordptr=NULL;
-                consumeFlag=true;
-                getNextFileRecord=true;
-            }
-            else{
-                writeRecordPtr = outputPipeRecordPtr;
-                outputPipeRecordPtr=NULL;
-                consumeFlag=true;
-                getNextOutputPipeRecord=true;
-            }
-        }
-        else if (fileReadFlag){
-            writeRecordPtr = fileRecordptr;
-            fileRecordptr=NULL;
-            consumeFlag=true;
-            getNextFileRecord=true;
 
-        }
-        else if (outputPipeReadFlag){
-            writeRecordPtr = outputPipeRecordPtr;
-            outputPipeRecordPtr=NULL;
-            consumeFlag=true;
-            getNextOutputPipeRecord=true;
-        }
-        
-        
-        if(consumeFlag && !page.Append(writeRecordPtr)) {
-            // Add the page to new File
-            newFile.AddPage(&page,newFilePageCounter);
-            newFilePageCounter++;
-            
-            // empty page if not consumed
-            if(page.getNumRecs() > 0){
-                page.EmptyItOut();
-            }
-            // add again to page
-            page.Append(writeRecordPtr);
-        }
-        if(writeRecordPtr!=NULL){
-            delete writeRecordPtr;
-        }
+    // write the sorted records to a segment of their own, the base file is not touched
+    pthread_mutex_lock(&segmentMutex);
+    int id = myPreferencePtr->nextSegmentId++;
+    pthread_mutex_unlock(&segmentMutex);
+    string segmentPath = GetSegmentPath(id);
+    string projectionPath = GetProjectionPath(id);
+    newFile.Open(0,(char *)segmentPath.c_str());
+    File projectionFile;
+    projectionFile.Open(0,(char *)projectionPath.c_str());
+    Page page;
+    Page projectionPage;
+    off_t segmentPages = 0;
+    off_t projectionPages = 0;
+    FenceIndex fences(*myPreferencePtr->orderMaker);
+    Record temp;
+    while(outputPipePtr->Remove(&temp)){
+        AppendProjection(projectionFile,projectionPage,projectionPages,temp);
+        AppendSorted(newFile,page,segmentPages,temp,fences);
     }
-    
-    // write the last page which might not be full.
-    if (page.getNumRecs() > 0){
-        newFile.AddPage(&page,newFilePageCounter);
+    if(page.getNumRecs() > 0){
+        newFile.AddPage(&page,segmentPages);
+        segmentPages++;
     }
-    
+    if(projectionPage.getNumRecs() > 0){
+        projectionFile.AddPage(&projectionPage,projectionPages);
+    }
+    newFile.Close();
+    projectionFile.Close();
+
     // set that all records in the input pipe buffer are written
     myPreferencePtr->allRecordsWritten=true;
-    
+
     // clean up the input pipe, output pipe and bigQ after use.
     delete inputPipePtr;
     delete outputPipePtr;
@@ -677,172 +1334,1377 @@ void SortedDBFile::MergeSortedInputWithFile(){
     inputPipePtr = NULL;
     outputPipePtr = NULL;
     bigQPtr = NULL;
-    
-    // close the files and swap the files
-    myFile.Close();
-    newFile.Close();
-    
-    string oldFileName = fileName.substr(0,fileName.find_last_of('.'))+".bin";
-    char* old_f_path = new char[oldFileName.length()+1];
-    strcpy(old_f_path, oldFileName.c_str());
-    
-    // deleting old file
-    if(Utilities::checkfileExist(old_f_path)) {
-        if( remove(old_f_path) != 0 )
-        cerr<< "Error deleting file" ;
-    }
-    // renaming new file to old file.
-    rename(new_f_path,old_f_path);
-    
-    //opening the new file.
-    myFile.Open(1,old_f_path);
-}
-
-int SortedDBFile::BinarySearch(Record &fetchme, Record &literal,off_t low, off_t high){
-    off_t mid = low + (high - low)/2;
-    while(low <= high){
-           if(mid != 0)
-                  myFile.GetPage(&myPage,mid);
-           else
-                  myFile.GetPage(&myPage,0);
-           myPage.GetFirst(&fetchme);
-           int comparisonResult = myCompEng.Compare(&literal, queryOrderMaker, &fetchme, myPreferencePtr->orderMaker);
-
-           if (comparisonResult == 0 ){
-               myPreferencePtr->currentPage = mid+1;
-               return 2;
-           }
-           else if (comparisonResult<0){
-               high = mid - 1;
-           }
-           if (comparisonResult > 0){
-                while(myPage.GetFirst(&fetchme)){
-                    int comparisonResultInsidePage = myCompEng.Compare(&literal, queryOrderMaker,&fetchme, myPreferencePtr->orderMaker);
-                    if(comparisonResultInsidePage<0){
-                        return 0;
-                    }
-                    else if(comparisonResultInsidePage == 0 ){
-                        myPreferencePtr->currentPage = mid+1;
-                        return 1;
-                    }
-                }
-                low = mid+1;
-           }
-          // calculate new mid using new low and high
-           mid = low+(high - low)/2;
-       }
-       return 0;
-}
 
-/*-----------------------------------END--------------------------------------------*/
-
-
-
-/*-----------------------------------------------------------------------------------*/
-//                   DBFILE CLASS FUNCTION DEFINATION
-/*-----------------------------------------------------------------------------------*/
-
-DBFile::DBFile () {
-    myFilePtr = NULL;
+    if(segmentPages == 0){
+        remove(segmentPath.c_str());
+        remove(projectionPath.c_str());
+        return;
+    }
+    fences.Write(GetFencePath(id).c_str());
+    CloseScan();
+
+    // wait for the compaction to make room if every segment slot is taken
+    pthread_mutex_lock(&segmentMutex);
+    bool full = myPreferencePtr->numSegments >= MAX_SEGMENTS;
+    pthread_mutex_unlock(&segmentMutex);
+    if(full){
+        WaitForCompaction();
+    }
+    pthread_mutex_lock(&segmentMutex);
+    SegmentInfo segment = {id, 0, segmentPages};
+    myPreferencePtr->segments[myPreferencePtr->numSegments] = segment;
+    myPreferencePtr->numSegments++;
+    pthread_mutex_unlock(&segmentMutex);
+    StartCompaction();
 }
 
-DBFile::~DBFile () {
-    delete myFilePtr;
-    myFilePtr = NULL;
-}
+void SortedDBFile::MergeSegments(vector<int> &ids, bool intoBase, int level){
+    // cursors over the inputs, oldest first. Only the compaction thread removes
+    // segments, so the inputs can be opened without holding the lock
+    vector<SegmentCursor *> cursors;
+    pthread_mutex_lock(&segmentMutex);
+    bool readBase = intoBase && GetBasePages() > 0;
+    int id = intoBase ? -1 : myPreferencePtr->nextSegmentId++;
+    pthread_mutex_unlock(&segmentMutex);
+    if(readBase){
+        string basePath = GetBasePath();
+        File * base = new File();
+        base->Open(1,(char *)basePath.c_str());
+        cursors.push_back(OpenSegmentCursor(base,0));
+    }
+    for(int i = 0; i < ids.size(); i++){
+        string segmentPath = GetSegmentPath(ids[i]);
+        File * segment = new File();
+        segment->Open(1,(char *)segmentPath.c_str());
+        cursors.push_back(OpenSegmentCursor(segment,0));
+    }
 
-int DBFile::Create (const char *f_path, fType f_type, void *startup) {
-    if (Utilities::checkfileExist(f_path)) {
-        cout << "file you are about to create already exists!"<<endl;
-        return 0;
+    // setup for new file
+    string fileName(myPreferencePtr->preferenceFilePath);
+    string newFileName = intoBase ? fileName.substr(0,fileName.find_last_of('.'))+".nbin" : GetSegmentPath(id);
+    string newFencePath = intoBase ? fileName.substr(0,fileName.find_last_of('.'))+".nfence" : GetFencePath(id);
+    string newProjectionPath = intoBase ? fileName.substr(0,fileName.find_last_of('.'))+".nproj" : GetProjectionPath(id);
+    File mergedFile;
+    mergedFile.Open(0,(char *)newFileName.c_str());
+    File projectionFile;
+    projectionFile.Open(0,(char *)newProjectionPath.c_str());
+    Page page;
+    Page projectionPage;
+    off_t newFilePageCounter = 0;
+    off_t projectionPages = 0;
+    FenceIndex fences(*myPreferencePtr->orderMaker);
+    Record temp;
+    while(NextFromSegmentCursors(cursors,temp,*myPreferencePtr->orderMaker,myCompEng)){
+        AppendProjection(projectionFile,projectionPage,projectionPages,temp);
+        AppendSorted(mergedFile,page,newFilePageCounter,temp,fences);
     }
-    // changing .bin extension to .pref for storing preferences.
-    string s(f_path);
-    string news = s.substr(0,s.find_last_of('.'))+".pref";
-    char* finalString = new char[news.length()+1];
-    strcpy(finalString, news.c_str());
-    // loading preferences
-    LoadPreference(finalString,f_type);
-    
-    // check if the file type is correct
-    if (f_type == heap){
-        myFilePtr = new HeapDBFile(&myPreference);
-        myFilePtr->Create((char *)f_path,f_type,startup);
-        return 1;
+    if(page.getNumRecs() > 0){
+        mergedFile.AddPage(&page,newFilePageCounter);
+        newFilePageCounter++;
     }
-    else if(f_type == sorted){
-        myFilePtr = new SortedDBFile(&myPreference);
-        myFilePtr->Create((char *)f_path,f_type,startup);
-        return 1;
+    if(projectionPage.getNumRecs() > 0){
+        projectionFile.AddPage(&projectionPage,projectionPages);
+    }
+    mergedFile.Close();
+    projectionFile.Close();
+    fences.Write(newFencePath.c_str());
+    for(int i = 0; i < cursors.size(); i++){
+        CloseSegmentCursor(cursors[i]);
     }
-    return 0;
-}
-
-int DBFile::Open (const char *f_path) {
 
-    if (!Utilities::checkfileExist(f_path)) {
-        cout << "Trying to open a file which is not created yet!"<<endl;
-        return 0;
+    // swap the result in: readers opening a scan see either all the inputs or the result
+    pthread_mutex_lock(&segmentMutex);
+    int kept = 0;
+    for(int i = 0; i < myPreferencePtr->numSegments; i++){
+        if(find(ids.begin(),ids.end(),myPreferencePtr->segments[i].id) == ids.end()){
+            myPreferencePtr->segments[kept] = myPreferencePtr->segments[i];
+            kept++;
+        }
     }
+    myPreferencePtr->numSegments = kept;
+    if(intoBase){
+        // rename replaces the base file atomically, open scans keep the old one
+        string basePath = GetBasePath();
+        rename(newFileName.c_str(),basePath.c_str());
+        rename(newFencePath.c_str(),GetFencePath(-1).c_str());
+        rename(newProjectionPath.c_str(),GetProjectionPath(-1).c_str());
+        baseReplaced = true;
+        basePages = newFilePageCounter;
+    }
+    else{
+        SegmentInfo segment = {id, level, newFilePageCounter};
+        myPreferencePtr->segments[myPreferencePtr->numSegments] = segment;
+        myPreferencePtr->numSegments++;
+    }
+    pthread_mutex_unlock(&segmentMutex);
 
-    // changing .bin extension to .pref for storing preferences.
-    string s(f_path);
-    string news = s.substr(0,s.find_last_of('.'))+".pref";
-    
-    char* finalString = new char[news.length()+1];
-    strcpy(finalString, news.c_str());
+    // scans that still read the merged segments hold them open
+    for(int i = 0; i < ids.size(); i++){
+        remove(GetSegmentPath(ids[i]).c_str());
+        remove(GetFencePath(ids[i]).c_str());
+        remove(GetProjectionPath(ids[i]).c_str());
+    }
+}
 
-    // loading preferences
-    LoadPreference(finalString,undefined);
-    
-    
-    // check if the file type is correct
-    if (myPreference.f_type == heap){
-        myFilePtr = new HeapDBFile(&myPreference);
+bool SortedDBFile::PickCompaction(vector<int> &ids, bool &intoBase, int &level){
+    ids.clear();
+    intoBase = false;
+    // fold everything into the base file once the segments are as large as it,
+    // so that reads never merge more data from segments than from the base
+    off_t segmentPages = 0;
+    for(int i = 0; i < myPreferencePtr->numSegments; i++){
+        segmentPages += myPreferencePtr->segments[i].pages;
     }
-    else if(myPreference.f_type == sorted){
-        myFilePtr = new SortedDBFile(&myPreference);
+    if(myPreferencePtr->numSegments > 0 && (segmentPages >= GetBasePages() || myPreferencePtr->numSegments >= MAX_SEGMENTS)){
+        for(int i = 0; i < myPreferencePtr->numSegments; i++){
+            ids.push_back(myPreferencePtr->segments[i].id);
+        }
+        intoBase = true;
+        level = 0;
+        return true;
     }
-    // opening file using given path
-    return myFilePtr->Open((char *)f_path);
+    if(myPreferencePtr->compactionPolicy == tiered){
+        // merge COMPACTION_FANOUT segments of a level into one of the next level
+        for(level = 0; level < MAX_SEGMENTS; level++){
+            ids.clear();
+            for(int i = 0; i < myPreferencePtr->numSegments; i++){
+                if(myPreferencePtr->segments[i].level == level){
+                    ids.push_back(myPreferencePtr->segments[i].id);
+                }
+            }
+            if(ids.size() >= COMPACTION_FANOUT){
+                level++;
+                return true;
+            }
+        }
+        return false;
+    }
+    // one segment per level: segments sharing a level are merged, and a segment
+    // moves down once it outgrows COMPACTION_FANOUT times the level above
+    for(int i = 0; i < myPreferencePtr->numSegments; i++){
+        level = myPreferencePtr->segments[i].level;
+        ids.clear();
+        for(int j = 0; j < myPreferencePtr->numSegments; j++){
+            if(myPreferencePtr->segments[j].level == level){
+                ids.push_back(myPreferencePtr->segments[j].id);
+            }
+        }
+        if(ids.size() > 1){
+            return true;
+        }
+        off_t capacity = myPreferencePtr->runLength > 0 ? myPreferencePtr->runLength : 1;
+        for(int j = 0; j <= level; j++){
+            capacity *= COMPACTION_FANOUT;
+        }
+        if(myPreferencePtr->segments[i].pages > capacity && level+1 < MAX_SEGMENTS){
+            myPreferencePtr->segments[i].level++;
+            // the segment may now share its level, look again from the start
+            i = -1;
+        }
+    }
+    ids.clear();
+    return false;
 }
 
-void DBFile::Add (Record &rec) {
-    if (myFilePtr!=NULL){
-        myFilePtr->Add(rec);
+void * SortedDBFile::CompactionWorker(void * arg){
+    SortedDBFile * dbFile = (SortedDBFile *) arg;
+    vector<int> ids;
+    bool intoBase;
+    int level;
+    // keep merging while the policy finds work, segments flushed meanwhile included
+    pthread_mutex_lock(&dbFile->segmentMutex);
+    while(dbFile->PickCompaction(ids,intoBase,level)){
+        pthread_mutex_unlock(&dbFile->segmentMutex);
+        dbFile->MergeSegments(ids,intoBase,level);
+        pthread_mutex_lock(&dbFile->segmentMutex);
     }
+    dbFile->compactionRunning = false;
+    pthread_mutex_unlock(&dbFile->segmentMutex);
+    return NULL;
 }
 
-void DBFile::Load (Schema &f_schema, const char *loadpath) {
-    if (myFilePtr!=NULL){
-           myFilePtr->Load(f_schema,loadpath);
+void SortedDBFile::StartCompaction(){
+    pthread_mutex_lock(&segmentMutex);
+    bool running = compactionRunning;
+    pthread_mutex_unlock(&segmentMutex);
+    // a running compaction picks up the new segment by itself
+    if(running){
+        return;
     }
+    WaitForCompaction();
+    compactionRunning = true;
+    compactionStarted = true;
+    pthread_create(&compactionThread, NULL, CompactionWorker, (void *)this);
 }
 
-void DBFile::MoveFirst () {
-    if (myFilePtr!=NULL){
-           myFilePtr->MoveFirst();
+void SortedDBFile::WaitForCompaction(){
+    if(compactionStarted){
+        pthread_join(compactionThread, NULL);
+        compactionStarted = false;
     }
 }
 
-int DBFile::Close () {
-    if (myFilePtr!=NULL){
-        if (myFilePtr->Close()){
-            DumpPreference();
-            return 1;
+void SortedDBFile::SyncBaseFile(){
+    pthread_mutex_lock(&segmentMutex);
+    ReopenBaseFile();
+    pthread_mutex_unlock(&segmentMutex);
+}
 
+void SortedDBFile::ReopenBaseFile(){
+    if(baseReplaced){
+        // reopen the base file written by the compaction
+        string basePath = GetBasePath();
+        if(myPage.getNumRecs() > 0){
+            myPage.EmptyItOut();
         }
-        else{
-            return 0;
-        };
+        myFile.Close();
+        myFile.Open(1,(char *)basePath.c_str());
+        myPreferencePtr->currentPage = 0;
+        myPreferencePtr->currentRecordPosition = 0;
+        delete baseFences;
+        baseFences = NULL;
+        baseReplaced = false;
+        basePages = -1;
     }
 }
 
-int DBFile::GetNext (Record &fetchme) {
-    if (myFilePtr != NULL){
-        return myFilePtr->GetNext(fetchme);
+FenceIndex * SortedDBFile::GetFences(File &file, int id){
+    FenceIndex * fences = id < 0 ? baseFences : NULL;
+    if(id >= 0 && segmentFences.find(id) != segmentFences.end()){
+        fences = segmentFences[id];
+    }
+    if(fences != NULL){
+        return fences;
+    }
+    // files written before fences were kept get them on their first lookup
+    fences = new FenceIndex(*myPreferencePtr->orderMaker);
+    string fencePath = GetFencePath(id);
+    if(!fences->Read(fencePath.c_str())){
+        fences->Build(file);
+        if(fences->GetNumPages() > 0){
+            fences->Write(fencePath.c_str());
+        }
+    }
+    if(id < 0){
+        baseFences = fences;
+    }
+    else{
+        segmentFences[id] = fences;
+    }
+    return fences;
+}
+
+void SortedDBFile::AppendSorted(File &file, Page &page, off_t &pages, Record &rec, FenceIndex &fences){
+    if(page.getNumRecs() == 0){
+        fences.AddPage(rec);
+    }
+    if(!page.Append(&rec)){
+        file.AddPage(&page,pages);
+        pages++;
+        page.EmptyItOut();
+        fences.AddPage(rec);
+        page.Append(&rec);
+    }
+}
+
+void SortedDBFile::AppendProjection(File &file, Page &page, off_t &pages, Record &rec){
+    Record projected;
+    MakeKeyRecord(rec, *myPreferencePtr->orderMaker, NULL, 0, projected);
+    if(!page.Append(&projected)){
+        file.AddPage(&page,pages);
+        pages++;
+        page.EmptyItOut();
+        page.Append(&projected);
+    }
+}
+
+void SortedDBFile::OpenProjectionScan(){
+    CloseProjectionScan();
+    projectionOrder.numAtts = myPreferencePtr->orderMaker->numAtts;
+    for(int i = 0; i < projectionOrder.numAtts; i++){
+        projectionOrder.whichAtts[i] = i;
+        projectionOrder.whichTypes[i] = myPreferencePtr->orderMaker->whichTypes[i];
+    }
+    // the projections are opened together, as in OpenScan, so that a compaction is seen whole
+    pthread_mutex_lock(&segmentMutex);
+    ReopenBaseFile();
+    vector<string> paths;
+    if(GetBasePages() > 0){
+        paths.push_back(GetProjectionPath(-1));
+    }
+    for(int i = 0; i < myPreferencePtr->numSegments; i++){
+        paths.push_back(GetProjectionPath(myPreferencePtr->segments[i].id));
+    }
+    // files written before projections were kept are read whole until the compaction rewrites them
+    projectRecords = false;
+    for(int i = 0; i < paths.size(); i++){
+        if(!Utilities::checkfileExist(paths[i])){
+            projectRecords = true;
+        }
+    }
+    for(int i = 0; !projectRecords && i < paths.size(); i++){
+        File * projection = new File();
+        projection->Open(1,(char *)paths[i].c_str());
+        projectionCursors.push_back(OpenSegmentCursor(projection,0));
+    }
+    pthread_mutex_unlock(&segmentMutex);
+    projectionOpen = true;
+}
+
+void SortedDBFile::CloseProjectionScan(){
+    for(int i = 0; i < projectionCursors.size(); i++){
+        CloseSegmentCursor(projectionCursors[i]);
+    }
+    projectionCursors.clear();
+    projectionOpen = false;
+}
+
+int SortedDBFile::GetNumIndexes(){
+    return myPreferencePtr->orderMaker != NULL ? 1 : 0;
+}
+
+void SortedDBFile::GetIndexKey(int index, OrderMaker &key){
+    key = *myPreferencePtr->orderMaker;
+}
+
+int SortedDBFile::GetSortOrder(OrderMaker &order){
+    order = *myPreferencePtr->orderMaker;
+    return 1;
+}
+
+int SortedDBFile::GetNextFromIndex(int index, Record &fetchme, CNF &cnf, Record &literal){
+    if (!myFile.IsFileOpen() || index != 0){
+        return 0;
+    }
+    if(myPreferencePtr->pageBufferMode == WRITE && !myPreferencePtr->allRecordsWritten){
+        FlushInputToSegment();
+    }
+    myPreferencePtr->pageBufferMode = READ;
+    if(!projectionOpen){
+        OpenProjectionScan();
+        cnf.GetRangeOrderMakers(projectionOrder, lowerBound, upperBound);
+    }
+    Record rec;
+    while(projectRecords ? GetNext(rec) : NextFromSegmentCursors(projectionCursors,rec,projectionOrder,myCompEng)){
+        if(projectRecords){
+            Record projected;
+            MakeKeyRecord(rec, *myPreferencePtr->orderMaker, NULL, 0, projected);
+            rec.Consume(&projected);
+        }
+        // the projection is in sort order, records past the upper bound can not match
+        if(upperBound.numAtts > 0 && myCompEng.Compare(&literal, &upperBound, &rec, &projectionOrder) < 0){
+            return 0;
+        }
+        if(myCompEng.Compare(&rec, &literal, &cnf)){
+            fetchme.Consume(&rec);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+bool SortedDBFile::HasSegments(){
+    pthread_mutex_lock(&segmentMutex);
+    bool hasSegments = myPreferencePtr->numSegments > 0;
+    pthread_mutex_unlock(&segmentMutex);
+    return hasSegments;
+}
+
+off_t SortedDBFile::GetBasePages(){
+    if(basePages >= 0){
+        return basePages;
+    }
+    return myFile.GetLength() > 0 ? myFile.GetLength()-1 : 0;
+}
+
+string SortedDBFile::GetFencePath(int id){
+    string fileName(myPreferencePtr->preferenceFilePath);
+    string stem = fileName.substr(0,fileName.find_last_of('.'));
+    return id < 0 ? stem+".fence" : stem+"."+to_string(id)+".fence";
+}
+
+string SortedDBFile::GetProjectionPath(int id){
+    string fileName(myPreferencePtr->preferenceFilePath);
+    string stem = fileName.substr(0,fileName.find_last_of('.'));
+    return id < 0 ? stem+".proj" : stem+"."+to_string(id)+".proj";
+}
+
+string SortedDBFile::GetBasePath(){
+    string fileName(myPreferencePtr->preferenceFilePath);
+    return fileName.substr(0,fileName.find_last_of('.'))+".bin";
+}
+
+/*-----------------------------------END--------------------------------------------*/
+
+
+
+/*-----------------------------------------------------------------------------------*/
+//                   TREE DBFILE CLASS FUNCTION DEFINATION
+/*-----------------------------------------------------------------------------------*/
+
+// builds a record made of ints only, used as the header of tree nodes
+static void MakeIntRecord(Record &rec, int *values, int numValues) {
+    int length = sizeof(int) * (2 * numValues + 1);
+    char *bits = new char[length];
+    ((int *) bits)[0] = length;
+    for (int i = 0; i < numValues; i++){
+        ((int *) bits)[i+1] = sizeof(int) * (numValues + 1 + i);
+        ((int *) bits)[numValues+1+i] = values[i];
+    }
+    delete [] rec.bits;
+    rec.bits = bits;
+}
+
+TreeDBFile :: TreeDBFile(Preference * preference){
+    myPreferencePtr = preference;
+    doSeek = true;
+    nextLeaf = preference->firstLeaf;
+    keyOrderMaker.numAtts = preference->orderMaker->numAtts;
+    for (int i = 0; i < keyOrderMaker.numAtts; i++){
+        keyOrderMaker.whichAtts[i] = i;
+        keyOrderMaker.whichTypes[i] = preference->orderMaker->whichTypes[i];
+    }
+}
+
+TreeDBFile::~TreeDBFile(){
+}
+
+void TreeDBFile::ReadNode(off_t whichPage, TreeNode &node){
+    Page page;
+    myFile.GetPage(&page, whichPage);
+    Record header;
+    page.GetFirst(&header);
+    char *bits = header.bits;
+    node.isLeaf = *((int *) (bits + ((int *) bits)[1]));
+    node.next = *((int *) (bits + ((int *) bits)[2]));
+    Record temp;
+    while (page.GetFirst(&temp)){
+        Record *entry = new Record();
+        entry->Consume(&temp);
+        node.entries.push_back(entry);
+    }
+}
+
+void TreeDBFile::WriteNode(off_t whichPage, TreeNode &node){
+    Page page;
+    Record temp;
+    int header[2] = {node.isLeaf, (int) node.next};
+    MakeIntRecord(temp, header, 2);
+    page.Append(&temp);
+    for (vector<Record *>::iterator i = node.entries.begin(); i != node.entries.end(); ++i){
+        temp.Copy(*i);
+        if (!page.Append(&temp)){
+            cerr << "BAD: tree node does not fit in a page\n";
+            exit(1);
+        }
+    }
+    myFile.AddPage(&page, whichPage);
+}
+
+void TreeDBFile::FreeNode(TreeNode &node){
+    for (vector<Record *>::iterator i = node.entries.begin(); i != node.entries.end(); ++i){
+        delete *i;
+    }
+    node.entries.clear();
+}
+
+int TreeDBFile::NodeBytes(TreeNode &node){
+    // record count of the page and the header record
+    int bytes = sizeof(int) + 5 * sizeof(int);
+    for (vector<Record *>::iterator i = node.entries.begin(); i != node.entries.end(); ++i){
+        bytes += ((int *) (*i)->bits)[0];
+    }
+    return bytes;
+}
+
+void TreeDBFile::MakeSeparator(Record &from, OrderMaker &fromOrder, off_t child, Record &separator){
+    int childPage = (int) child;
+    MakeKeyRecord(from, fromOrder, &childPage, 1, separator);
+}
+
+off_t TreeDBFile::GetChild(Record *separator){
+    char *bits = separator->bits;
+    return *((int *) (bits + ((int *) bits)[keyOrderMaker.numAtts+1]));
+}
+
+void TreeDBFile::SplitNode(off_t whichPage, TreeNode &node, Record &separator){
+    // split by bytes so that both halves fit whatever the record sizes
+    int half = NodeBytes(node) / 2;
+    int bytes = 0;
+    int splitAt = 0;
+    while (splitAt < node.entries.size()-1 && bytes < half){
+        bytes += ((int *) node.entries[splitAt]->bits)[0];
+        splitAt++;
+    }
+    if (splitAt == 0){
+        splitAt = 1;
+    }
+    TreeNode right;
+    right.isLeaf = node.isLeaf;
+    right.next = node.next;
+    right.entries.assign(node.entries.begin() + splitAt, node.entries.end());
+    node.entries.resize(splitAt);
+
+    // the new node goes at the end of the file, nothing else moves
+    off_t rightPage = GetPageLocationToWrite();
+    if (node.isLeaf){
+        node.next = rightPage;
+        MakeSeparator(*right.entries[0], *myPreferencePtr->orderMaker, rightPage, separator);
+    }
+    else{
+        MakeSeparator(*right.entries[0], keyOrderMaker, rightPage, separator);
+    }
+    WriteNode(rightPage, right);
+    WriteNode(whichPage, node);
+    FreeNode(right);
+}
+
+void TreeDBFile::InsertRange(off_t whichPage, vector<Record *> &recs, int low, int high, vector<Record *> &separators){
+    TreeNode node;
+    ReadNode(whichPage, node);
+    vector<Record *> entries;
+    if (node.isLeaf){
+        // merge the records in, equal keys keep their insertion order
+        int i = 0;
+        for (int j = low; j < high; j++){
+            while (i < node.entries.size() && myCompEng.Compare(node.entries[i], recs[j], myPreferencePtr->orderMaker) <= 0){
+                entries.push_back(node.entries[i++]);
+            }
+            Record *entry = new Record();
+            entry->Copy(recs[j]);
+            entries.push_back(entry);
+        }
+        while (i < node.entries.size()){
+            entries.push_back(node.entries[i++]);
+        }
+    }
+    else{
+        int next = low;
+        for (int c = 0; c < node.entries.size(); c++){
+            entries.push_back(node.entries[c]);
+            // the records smaller than the next separator go below this child
+            int end = next;
+            while (end < high && (c+1 == node.entries.size() ||
+                myCompEng.Compare(recs[end], myPreferencePtr->orderMaker, node.entries[c+1], &keyOrderMaker) < 0)){
+                end++;
+            }
+            if (end > next){
+                vector<Record *> childSeparators;
+                InsertRange(GetChild(node.entries[c]), recs, next, end, childSeparators);
+                entries.insert(entries.end(), childSeparators.begin(), childSeparators.end());
+                next = end;
+            }
+        }
+    }
+    node.entries.swap(entries);
+    WriteSplit(whichPage, node, separators);
+    FreeNode(node);
+}
+
+void TreeDBFile::WriteSplit(off_t whichPage, TreeNode &node, vector<Record *> &separators){
+    // cut the entries into pieces of about the same size that each fit a page
+    int nodeBytes = NodeBytes(node);
+    int target = nodeBytes / (nodeBytes / PAGE_SIZE + 1);
+    int emptyBytes = sizeof(int) + 5 * sizeof(int);
+    vector<int> starts;
+    starts.push_back(0);
+    int bytes = emptyBytes;
+    for (int i = 0; i < node.entries.size(); i++){
+        int entryBytes = ((int *) node.entries[i]->bits)[0];
+        if (i > starts.back() && (bytes >= target || bytes + entryBytes > PAGE_SIZE)){
+            starts.push_back(i);
+            bytes = emptyBytes;
+        }
+        bytes += entryBytes;
+    }
+    starts.push_back(node.entries.size());
+
+    // the first piece stays in place, the others go at the end of the file
+    off_t newPage = GetPageLocationToWrite();
+    if (newPage <= whichPage){
+        newPage = whichPage + 1;
+    }
+    for (int p = 0; p+1 < starts.size(); p++){
+        off_t piecePage = p == 0 ? whichPage : newPage + p - 1;
+        TreeNode piece;
+        piece.isLeaf = node.isLeaf;
+        piece.next = (node.isLeaf && p+2 < starts.size()) ? newPage + p : node.next;
+        piece.entries.assign(node.entries.begin() + starts[p], node.entries.begin() + starts[p+1]);
+        if (p > 0){
+            separators.push_back(new Record());
+            MakeSeparator(*piece.entries[0], node.isLeaf ? *myPreferencePtr->orderMaker : keyOrderMaker, piecePage, *separators.back());
+        }
+        WriteNode(piecePage, piece);
+    }
+}
+
+void TreeDBFile::InsertBatch(vector<Record *> &recs){
+    if (recs.empty()){
+        return;
+    }
+    if (myPreferencePtr->rootPage < 0){
+        TreeNode leaf;
+        leaf.isLeaf = true;
+        leaf.next = -1;
+        myPreferencePtr->rootPage = GetPageLocationToWrite();
+        myPreferencePtr->firstLeaf = myPreferencePtr->rootPage;
+        WriteNode(myPreferencePtr->rootPage, leaf);
+    }
+    vector<Record *> separators;
+    InsertRange(myPreferencePtr->rootPage, recs, 0, recs.size(), separators);
+    while (!separators.empty()){
+        // the root split, so the tree grows by one level
+        TreeNode root;
+        root.isLeaf = false;
+        root.next = -1;
+        Record *first = new Record();
+        first->Copy(separators[0]);
+        char *bits = first->bits;
+        *((int *) (bits + ((int *) bits)[keyOrderMaker.numAtts+1])) = (int) myPreferencePtr->rootPage;
+        root.entries.push_back(first);
+        root.entries.insert(root.entries.end(), separators.begin(), separators.end());
+        separators.clear();
+        myPreferencePtr->rootPage = GetPageLocationToWrite();
+        WriteSplit(myPreferencePtr->rootPage, root, separators);
+        FreeNode(root);
     }
-    return 0;
+}
+
+bool TreeDBFile::InsertInto(off_t whichPage, Record &rec, Record &separator){
+    TreeNode node;
+    ReadNode(whichPage, node);
+
+    // find the first entry greater than rec, equal keys keep their insertion order
+    int low = node.isLeaf ? 0 : 1;
+    int high = node.entries.size();
+    while (low < high){
+        int mid = low + (high - low) / 2;
+        int result = node.isLeaf ?
+            myCompEng.Compare(&rec, node.entries[mid], myPreferencePtr->orderMaker) :
+            myCompEng.Compare(&rec, myPreferencePtr->orderMaker, node.entries[mid], &keyOrderMaker);
+        if (result < 0){
+            high = mid;
+        }
+        else{
+            low = mid + 1;
+        }
+    }
+
+    if (node.isLeaf){
+        Record *entry = new Record();
+        entry->Copy(&rec);
+        node.entries.insert(node.entries.begin() + low, entry);
+    }
+    else{
+        // the first separator of a node stands for every key below the second one
+        Record childSeparator;
+        if (!InsertInto(GetChild(node.entries[low-1]), rec, childSeparator)){
+            FreeNode(node);
+            return false;
+        }
+        Record *entry = new Record();
+        entry->Consume(&childSeparator);
+        node.entries.insert(node.entries.begin() + low, entry);
+    }
+
+    bool split = NodeBytes(node) > PAGE_SIZE;
+    if (split){
+        SplitNode(whichPage, node, separator);
+    }
+    else{
+        WriteNode(whichPage, node);
+    }
+    FreeNode(node);
+    return split;
+}
+
+void TreeDBFile::Insert(Record &rec){
+    if (myPreferencePtr->rootPage < 0){
+        TreeNode leaf;
+        leaf.isLeaf = true;
+        leaf.next = -1;
+        myPreferencePtr->rootPage = GetPageLocationToWrite();
+        myPreferencePtr->firstLeaf = myPreferencePtr->rootPage;
+        WriteNode(myPreferencePtr->rootPage, leaf);
+    }
+    Record separator;
+    if (InsertInto(myPreferencePtr->rootPage, rec, separator)){
+        // the root split, so the tree grows by one level
+        TreeNode root;
+        root.isLeaf = false;
+        root.next = -1;
+        Record *first = new Record();
+        first->Copy(&separator);
+        char *bits = first->bits;
+        *((int *) (bits + ((int *) bits)[keyOrderMaker.numAtts+1])) = (int) myPreferencePtr->rootPage;
+        Record *second = new Record();
+        second->Consume(&separator);
+        root.entries.push_back(first);
+        root.entries.push_back(second);
+        myPreferencePtr->rootPage = GetPageLocationToWrite();
+        WriteNode(myPreferencePtr->rootPage, root);
+        FreeNode(root);
+    }
+}
+
+void TreeDBFile::BulkLoad(Pipe &sortedInput){
+    // fill the leaves one after the other, then build each level over the one below
+    vector<Record *> level;
+    TreeNode node;
+    node.isLeaf = true;
+    node.next = -1;
+    off_t nodePage = GetPageLocationToWrite();
+    myPreferencePtr->firstLeaf = nodePage;
+    Record rec;
+    while (sortedInput.Remove(&rec)){
+        Record *entry = new Record();
+        entry->Consume(&rec);
+        node.entries.push_back(entry);
+        if (node.entries.size() > 1 && NodeBytes(node) > PAGE_SIZE){
+            node.entries.pop_back();
+            node.next = nodePage + 1;
+            WriteNode(nodePage, node);
+            level.push_back(new Record());
+            MakeSeparator(*node.entries[0], *myPreferencePtr->orderMaker, nodePage, *level.back());
+            FreeNode(node);
+            node.entries.push_back(entry);
+            nodePage++;
+        }
+    }
+    node.next = -1;
+    WriteNode(nodePage, node);
+    if (!node.entries.empty()){
+        level.push_back(new Record());
+        MakeSeparator(*node.entries[0], *myPreferencePtr->orderMaker, nodePage, *level.back());
+    }
+    FreeNode(node);
+    myPreferencePtr->rootPage = nodePage;
+
+    while (level.size() > 1){
+        vector<Record *> upper;
+        node.isLeaf = false;
+        node.next = -1;
+        for (vector<Record *>::iterator i = level.begin(); i != level.end(); ++i){
+            node.entries.push_back(*i);
+            if (node.entries.size() > 1 && NodeBytes(node) > PAGE_SIZE){
+                node.entries.pop_back();
+                nodePage++;
+                WriteNode(nodePage, node);
+                upper.push_back(new Record());
+                MakeSeparator(*node.entries[0], keyOrderMaker, nodePage, *upper.back());
+                FreeNode(node);
+                node.entries.push_back(*i);
+            }
+        }
+        nodePage++;
+        WriteNode(nodePage, node);
+        upper.push_back(new Record());
+        MakeSeparator(*node.entries[0], keyOrderMaker, nodePage, *upper.back());
+        FreeNode(node);
+        level.swap(upper);
+        myPreferencePtr->rootPage = nodePage;
+    }
+    for (vector<Record *>::iterator i = level.begin(); i != level.end(); ++i){
+        delete *i;
+    }
+}
+
+void TreeDBFile::SeekTo(Record &literal, OrderMaker &queryOrder){
+    OrderMaker keyPrefix = keyOrderMaker;
+    keyPrefix.numAtts = queryOrder.numAtts;
+    off_t whichPage = myPreferencePtr->rootPage;
+    TreeNode node;
+    ReadNode(whichPage, node);
+    while (!node.isLeaf){
+        // go below the last separator smaller than the literal
+        int low = 1;
+        int high = node.entries.size();
+        while (low < high){
+            int mid = low + (high - low) / 2;
+            if (myCompEng.Compare(&literal, &queryOrder, node.entries[mid], &keyPrefix) > 0){
+                low = mid + 1;
+            }
+            else{
+                high = mid;
+            }
+        }
+        whichPage = GetChild(node.entries[low-1]);
+        FreeNode(node);
+        ReadNode(whichPage, node);
+    }
+    FreeNode(node);
+    myPage.EmptyItOut();
+    nextLeaf = whichPage;
+}
+
+void TreeDBFile::MoveFirst () {
+    myPage.EmptyItOut();
+    hasPageOverflow = false;
+    nextLeaf = myPreferencePtr->firstLeaf;
+    doSeek = true;
+}
+
+void TreeDBFile::Add (Record &addme) {
+    if (!myFile.IsFileOpen()){
+        cerr << "Trying to load a file which is not open!";
+        exit(1);
+    }
+    Insert(addme);
+}
+
+void TreeDBFile::Load (Schema &myschema, const char *loadpath) {
+    if (!myFile.IsFileOpen()){
+        cerr << "Trying to load a file which is not open!";
+        exit(1);
+    }
+    // sort the input first, an empty tree is then built bottom up with full pages
+    Pipe inputPipe(100);
+    Pipe outputPipe(100);
+    int runLength = myPreferencePtr->runLength > 0 ? myPreferencePtr->runLength : 1;
+    BigQ bigQ(inputPipe, outputPipe, *(myPreferencePtr->orderMaker), runLength);
+    FILE *tableFile = fopen (loadpath, "r");
+    Record temp;
+    while(temp.SuckNextRecord(&myschema, tableFile)==1) {
+        inputPipe.Insert(&temp);
+    }
+    fclose(tableFile);
+    inputPipe.ShutDown();
+    AddSorted(outputPipe);
+    bigQ.WaitUntilDone();
+    MoveFirst();
+}
+
+void TreeDBFile::AddSorted(Pipe &sortedInput) {
+    if (myPreferencePtr->rootPage < 0){
+        BulkLoad(sortedInput);
+    }
+    else{
+        Record temp;
+        while (sortedInput.Remove(&temp)){
+            Insert(temp);
+        }
+    }
+}
+
+int TreeDBFile::GetNext (Record &fetchme) {
+    doSeek = false;
+    while (!myPage.GetFirst(&fetchme)){
+        if (nextLeaf < 0){
+            return 0;
+        }
+        myFile.GetPage(&myPage, nextLeaf);
+        Record header;
+        myPage.GetFirst(&header);
+        char *bits = header.bits;
+        nextLeaf = *((int *) (bits + ((int *) bits)[2]));
+    }
+    return 1;
+}
+
+int TreeDBFile::GetNextMatch (Record &fetchme, OrderMaker &queryOrder, Record &literal) {
+    if (doSeek && myPreferencePtr->rootPage >= 0){
+        SeekTo(literal, queryOrder);
+    }
+    while (GetNext(fetchme)){
+        int result = myCompEng.Compare(&literal, &queryOrder, &fetchme, myPreferencePtr->orderMaker);
+        // records after the matching keys can not match
+        if (result < 0){
+            return 0;
+        }
+        // records of the leaf before the matching keys
+        if (result == 0){
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int TreeDBFile::GetNext (Record &fetchme, CNF &cnf, Record &literal) {
+    if (doSeek){
+        // descend to the leaf of the lower bound, equalities and ranges alike
+        cnf.GetRangeOrderMakers(*myPreferencePtr->orderMaker, lowerBound, upperBound);
+        if (lowerBound.numAtts > 0 && myPreferencePtr->rootPage >= 0){
+            SeekTo(literal, lowerBound);
+        }
+    }
+    while (GetNext(fetchme)){
+        // records past the upper bound can not match
+        if (upperBound.numAtts > 0 && myCompEng.Compare(&literal, &upperBound, &fetchme, myPreferencePtr->orderMaker) < 0){
+            return 0;
+        }
+        if (myCompEng.Compare(&fetchme, &literal, &cnf)){
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int TreeDBFile::GetSortOrder (OrderMaker &order) {
+    order = *myPreferencePtr->orderMaker;
+    return 1;
+}
+
+int TreeDBFile::Close () {
+    if (!myFile.IsFileOpen()) {
+        cout << "trying to close a file which is not open!"<<endl;
+        return 0;
+    }
+    myFile.Close();
+    return 1;
+}
+
+/*-----------------------------------END--------------------------------------------*/
+
+
+
+/*-----------------------------------------------------------------------------------*/
+//                   HASH DBFILE CLASS FUNCTION DEFINATION
+/*-----------------------------------------------------------------------------------*/
+HashDBFile :: HashDBFile(Preference * preference){
+    myPreferencePtr = preference;
+    directoryLoaded = false;
+    allocatedPages = 0;
+    bufferedBytes = 0;
+    scanBucket = 0;
+    scanPage = 0;
+    scanEnd = -1;
+    doProbe = true;
+}
+
+HashDBFile::~HashDBFile(){
+    for (int i = 0; i < insertBuffer.size(); i++){
+        delete insertBuffer[i];
+    }
+}
+
+string HashDBFile::GetDirectoryPath(){
+    string fileName(myPreferencePtr->preferenceFilePath);
+    return fileName.substr(0,fileName.find_last_of('.'))+".dir";
+}
+
+void HashDBFile::LoadDirectory(){
+    if (directoryLoaded){
+        return;
+    }
+    directoryLoaded = true;
+    allocatedPages = myFile.GetLength() > 0 ? myFile.GetLength()-1 : 0;
+    string directoryPath = GetDirectoryPath();
+    FILE *directoryFile = fopen(directoryPath.c_str(), "rb");
+    if (directoryFile == NULL){
+        // a new file starts with its initial buckets, all empty
+        bucketPages.resize(HASH_INITIAL_BUCKETS);
+        return;
+    }
+    int numBuckets = 0;
+    fread(&numBuckets, sizeof(int), 1, directoryFile);
+    bucketPages.resize(numBuckets);
+    for (int i = 0; i < numBuckets; i++){
+        int chainLength = 0;
+        fread(&chainLength, sizeof(int), 1, directoryFile);
+        bucketPages[i].resize(chainLength);
+        if (chainLength > 0){
+            fread(&bucketPages[i][0], sizeof(off_t), chainLength, directoryFile);
+        }
+    }
+    int numFree = 0;
+    fread(&numFree, sizeof(int), 1, directoryFile);
+    freePages.resize(numFree);
+    if (numFree > 0){
+        fread(&freePages[0], sizeof(off_t), numFree, directoryFile);
+    }
+    fclose(directoryFile);
+}
+
+void HashDBFile::WriteDirectory(){
+    string directoryPath = GetDirectoryPath();
+    FILE *directoryFile = fopen(directoryPath.c_str(), "wb");
+    if (directoryFile == NULL){
+        cerr << "Error in opening " << directoryPath << " for writing.." << endl;
+        exit(1);
+    }
+    int numBuckets = bucketPages.size();
+    fwrite(&numBuckets, sizeof(int), 1, directoryFile);
+    for (int i = 0; i < numBuckets; i++){
+        int chainLength = bucketPages[i].size();
+        fwrite(&chainLength, sizeof(int), 1, directoryFile);
+        if (chainLength > 0){
+            fwrite(&bucketPages[i][0], sizeof(off_t), chainLength, directoryFile);
+        }
+    }
+    int numFree = freePages.size();
+    fwrite(&numFree, sizeof(int), 1, directoryFile);
+    if (numFree > 0){
+        fwrite(&freePages[0], sizeof(off_t), numFree, directoryFile);
+    }
+    fclose(directoryFile);
+}
+
+int HashDBFile::GetBucket(unsigned long hash){
+    // buckets before hashNext were already split and use the next level
+    unsigned long buckets = (unsigned long) HASH_INITIAL_BUCKETS << myPreferencePtr->hashLevel;
+    int bucket = hash % buckets;
+    if (bucket < myPreferencePtr->hashNext){
+        bucket = hash % (buckets << 1);
+    }
+    return bucket;
+}
+
+off_t HashDBFile::AllocatePage(){
+    if (!freePages.empty()){
+        off_t whichPage = freePages.back();
+        freePages.pop_back();
+        return whichPage;
+    }
+    return allocatedPages++;
+}
+
+void HashDBFile::AppendToBucket(int bucket, vector<Record *> &records){
+    if (records.empty()){
+        return;
+    }
+    // the records go after the last page of the chain, that page is read once
+    Page page;
+    off_t whichPage;
+    if (bucketPages[bucket].empty()){
+        whichPage = AllocatePage();
+        bucketPages[bucket].push_back(whichPage);
+    }
+    else{
+        whichPage = bucketPages[bucket].back();
+        myFile.GetPage(&page, whichPage);
+    }
+    for (int i = 0; i < records.size(); i++){
+        if (!page.Append(records[i])){
+            if (page.getNumRecs() == 0){
+                cerr << "BAD: record does not fit in a hash bucket page\n";
+                exit(1);
+            }
+            myFile.AddPage(&page, whichPage);
+            page.EmptyItOut();
+            whichPage = AllocatePage();
+            bucketPages[bucket].push_back(whichPage);
+            page.Append(records[i]);
+        }
+    }
+    myFile.AddPage(&page, whichPage);
+}
+
+void HashDBFile::FlushInsertBuffer(){
+    if (insertBuffer.empty()){
+        return;
+    }
+    LoadDirectory();
+    // group the records by bucket so that every bucket is written once
+    vector<pair<int, int> > order;
+    for (int i = 0; i < insertBuffer.size(); i++){
+        order.push_back(make_pair(GetBucket(myPreferencePtr->orderMaker->Hash(insertBuffer[i])), i));
+    }
+    sort(order.begin(), order.end());
+    vector<Record *> group;
+    for (int i = 0; i < order.size(); i++){
+        group.push_back(insertBuffer[order[i].second]);
+        if (i+1 == order.size() || order[i+1].first != order[i].first){
+            AppendToBucket(order[i].first, group);
+            group.clear();
+        }
+    }
+    for (int i = 0; i < insertBuffer.size(); i++){
+        delete insertBuffer[i];
+    }
+    insertBuffer.clear();
+    bufferedBytes = 0;
+
+    // split until the buckets hold HASH_FILL_PERCENT of a page on average
+    while (myPreferencePtr->hashBytes * 100 > (long long) bucketPages.size() * PAGE_SIZE * HASH_FILL_PERCENT){
+        SplitBucket();
+    }
+}
+
+void HashDBFile::SplitBucket(){
+    int bucket = myPreferencePtr->hashNext;
+    // read the whole chain, its pages are reused by the two halves
+    vector<Record *> records;
+    Page page;
+    for (int i = 0; i < bucketPages[bucket].size(); i++){
+        myFile.GetPage(&page, bucketPages[bucket][i]);
+        Record *rec = new Record();
+        while (page.GetFirst(rec)){
+            records.push_back(rec);
+            rec = new Record();
+        }
+        delete rec;
+    }
+    for (int i = bucketPages[bucket].size()-1; i >= 0; i--){
+        freePages.push_back(bucketPages[bucket][i]);
+    }
+    bucketPages[bucket].clear();
+    bucketPages.push_back(vector<off_t>());
+
+    myPreferencePtr->hashNext++;
+    if (myPreferencePtr->hashNext == (HASH_INITIAL_BUCKETS << myPreferencePtr->hashLevel)){
+        myPreferencePtr->hashLevel++;
+        myPreferencePtr->hashNext = 0;
+    }
+
+    vector<Record *> stay;
+    vector<Record *> move;
+    for (int i = 0; i < records.size(); i++){
+        if (GetBucket(myPreferencePtr->orderMaker->Hash(records[i])) == bucket){
+            stay.push_back(records[i]);
+        }
+        else{
+            move.push_back(records[i]);
+        }
+    }
+    AppendToBucket(bucket, stay);
+    AppendToBucket(bucketPages.size()-1, move);
+    for (int i = 0; i < records.size(); i++){
+        delete records[i];
+    }
+}
+
+void HashDBFile::MoveFirst () {
+    myPage.EmptyItOut();
+    hasPageOverflow = false;
+    scanBucket = 0;
+    scanPage = 0;
+    scanEnd = -1;
+    doProbe = true;
+}
+
+void HashDBFile::Add (Record &addme) {
+    if (!myFile.IsFileOpen()){
+        cerr << "Trying to load a file which is not open!";
+        exit(1);
+    }
+    Record *rec = new Record();
+    rec->Consume(&addme);
+    int length = ((int *) rec->bits)[0];
+    insertBuffer.push_back(rec);
+    bufferedBytes += length;
+    myPreferencePtr->hashBytes += length;
+    if (bufferedBytes >= HASH_BUFFER_BYTES){
+        FlushInsertBuffer();
+    }
+}
+
+void HashDBFile::Load (Schema &myschema, const char *loadpath) {
+    if (!myFile.IsFileOpen()){
+        cerr << "Trying to load a file which is not open!";
+        exit(1);
+    }
+    FILE *tableFile = fopen (loadpath, "r");
+    Record temp;
+    while(temp.SuckNextRecord(&myschema, tableFile)==1) {
+        Add(temp);
+    }
+    fclose(tableFile);
+    FlushInsertBuffer();
+}
+
+int HashDBFile::GetNext (Record &fetchme) {
+    FlushInsertBuffer();
+    LoadDirectory();
+    if (scanEnd < 0){
+        scanEnd = bucketPages.size();
+    }
+    while (!myPage.GetFirst(&fetchme)){
+        // next page of the chain, or the first page of the next bucket
+        while (scanBucket < scanEnd && scanPage >= bucketPages[scanBucket].size()){
+            scanBucket++;
+            scanPage = 0;
+        }
+        if (scanBucket >= scanEnd){
+            return 0;
+        }
+        myFile.GetPage(&myPage, bucketPages[scanBucket][scanPage]);
+        scanPage++;
+    }
+    return 1;
+}
+
+int HashDBFile::GetNext (Record &fetchme, CNF &cnf, Record &literal) {
+    if (doProbe){
+        doProbe = false;
+        FlushInsertBuffer();
+        LoadDirectory();
+        // with every key attribute pinned by an equality only one bucket can match
+        OrderMaker *queryOrderMaker = cnf.GetQueryOrderMaker(*myPreferencePtr->orderMaker);
+        if (queryOrderMaker != NULL && queryOrderMaker->numAtts == myPreferencePtr->orderMaker->numAtts
+            && scanBucket == 0 && scanPage == 0){
+            scanBucket = GetBucket(queryOrderMaker->Hash(&literal));
+            scanEnd = scanBucket + 1;
+        }
+        delete queryOrderMaker;
+    }
+    while (GetNext(fetchme)){
+        if (myCompEng.Compare(&fetchme, &literal, &cnf)){
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int HashDBFile::Close () {
+    if (!myFile.IsFileOpen()) {
+        cout << "trying to close a file which is not open!"<<endl;
+        return 0;
+    }
+    FlushInsertBuffer();
+    if (directoryLoaded){
+        WriteDirectory();
+    }
+    myFile.Close();
+    return 1;
+}
+
+/*-----------------------------------END--------------------------------------------*/
+
+
+
+/*-----------------------------------------------------------------------------------*/
+//                   DBFILE CLASS FUNCTION DEFINATION
+/*-----------------------------------------------------------------------------------*/
+
+DBFile::DBFile () {
+    myFilePtr = NULL;
+}
+
+DBFile::~DBFile () {
+    delete myFilePtr;
+    myFilePtr = NULL;
+}
+
+int DBFile::Create (const char *f_path, fType f_type, void *startup) {
+    if (Utilities::checkfileExist(f_path)) {
+        cout << "file you are about to create already exists!"<<endl;
+        return 0;
+    }
+    // changing .bin extension to .pref for storing preferences.
+    string s(f_path);
+    string news = s.substr(0,s.find_last_of('.'))+".pref";
+    char* finalString = new char[news.length()+1];
+    strcpy(finalString, news.c_str());
+    // loading preferences
+    LoadPreference(finalString,f_type);
+    
+    // check if the file type is correct
+    if (f_type == heap){
+        myFilePtr = new HeapDBFile(&myPreference);
+        myFilePtr->Create((char *)f_path,f_type,startup);
+        return 1;
+    }
+    else if(f_type == sorted){
+        myFilePtr = new SortedDBFile(&myPreference);
+        myFilePtr->Create((char *)f_path,f_type,startup);
+        return 1;
+    }
+    else if(f_type == tree){
+        if (startup == NULL){
+            cout << "a tree file needs the sort order to build it on!"<<endl;
+            return 0;
+        }
+        myPreference.orderMaker = ((SortedStartUp *)startup)->o;
+        myFilePtr = new TreeDBFile(&myPreference);
+        myFilePtr->Create((char *)f_path,f_type,startup);
+        return 1;
+    }
+    else if(f_type == hashed){
+        if (startup == NULL){
+            cout << "a hash file needs the key attributes to hash on!"<<endl;
+            return 0;
+        }
+        myPreference.orderMaker = ((SortedStartUp *)startup)->o;
+        myFilePtr = new HashDBFile(&myPreference);
+        myFilePtr->Create((char *)f_path,f_type,startup);
+        return 1;
+    }
+    return 0;
+}
+
+int DBFile::Open (const char *f_path) {
+
+    if (!Utilities::checkfileExist(f_path)) {
+        cout << "Trying to open a file which is not created yet!"<<endl;
+        return 0;
+    }
+
+    // changing .bin extension to .pref for storing preferences.
+    string s(f_path);
+    string news = s.substr(0,s.find_last_of('.'))+".pref";
+    
+    char* finalString = new char[news.length()+1];
+    strcpy(finalString, news.c_str());
+
+    // loading preferences
+    LoadPreference(finalString,undefined);
+    
+    
+    // check if the file type is correct
+    if (myPreference.f_type == heap){
+        myFilePtr = new HeapDBFile(&myPreference);
+    }
+    else if(myPreference.f_type == sorted){
+        myFilePtr = new SortedDBFile(&myPreference);
+    }
+    else if(myPreference.f_type == tree){
+        myFilePtr = new TreeDBFile(&myPreference);
+    }
+    else if(myPreference.f_type == hashed){
+        myFilePtr = new HashDBFile(&myPreference);
+    }
+    // opening file using given path
+    return myFilePtr->Open((char *)f_path);
+}
+
+void DBFile::Add (Record &rec) {
+    if (myFilePtr!=NULL){
+        myFilePtr->Add(rec);
+    }
+}
+
+void DBFile::AddBatch (Record *recs, int numRecords) {
+    if (myFilePtr!=NULL){
+        myFilePtr->AddBatch(recs, numRecords);
+    }
+}
+
+void DBFile::AddBatch (Page &page) {
+    if (myFilePtr!=NULL){
+        myFilePtr->AddBatch(page);
+    }
+}
+
+void DBFile::Load (Schema &f_schema, const char *loadpath) {
+    if (myFilePtr!=NULL){
+           myFilePtr->Load(f_schema,loadpath);
+    }
+}
+
+void DBFile::MoveFirst () {
+    if (myFilePtr!=NULL){
+           myFilePtr->MoveFirst();
+    }
+}
+
+int DBFile::Close () {
+    if (myFilePtr!=NULL){
+        if (myFilePtr->Close()){
+            DumpPreference();
+            return 1;
+
+        }
+        else{
+            return 0;
+        };
+    }
+}
+
+int DBFile::GetNext (Record &fetchme) {
+    if (myFilePtr != NULL){
+        return myFilePtr->GetNext(fetchme);
+    }
+    return 0;
 }
 
 int DBFile::GetNext (Record &fetchme, CNF &cnf, Record &literal) {
@@ -852,6 +2714,79 @@ int DBFile::GetNext (Record &fetchme, CNF &cnf, Record &literal) {
     return 0;
 }
 
+int DBFile::GetNextPage (Page &fetchme) {
+    if (myFilePtr!=NULL){
+        return myFilePtr->GetNextPage(fetchme);
+    }
+    return 0;
+}
+
+Cursor * DBFile::OpenCursor () {
+    if (myFilePtr!=NULL){
+        return myFilePtr->OpenCursor();
+    }
+    return NULL;
+}
+
+int DBFile::GetSortOrder (OrderMaker &order) {
+    if (myFilePtr!=NULL){
+        return myFilePtr->GetSortOrder(order);
+    }
+    order.numAtts = 0;
+    return 0;
+}
+
+File * DBFile::GetPageFile (off_t &numPages) {
+    if (myFilePtr!=NULL){
+        return myFilePtr->GetPageFile(numPages);
+    }
+    numPages = 0;
+    return NULL;
+}
+
+int DBFile::GetRecord (RecordId rid, Record &fetchme) {
+    if (myFilePtr != NULL){
+        return myFilePtr->GetRecord(rid,fetchme);
+    }
+    return 0;
+}
+
+RecordId DBFile::GetRecordId () {
+    if (myFilePtr != NULL){
+        return myFilePtr->GetRecordId();
+    }
+    RecordId rid = {-1, -1};
+    return rid;
+}
+
+int DBFile::CreateIndex (OrderMaker &key) {
+    if (myFilePtr != NULL){
+        return myFilePtr->CreateIndex(key);
+    }
+    return 0;
+}
+
+int DBFile::GetNumIndexes () {
+    if (myFilePtr != NULL){
+        return myFilePtr->GetNumIndexes();
+    }
+    return 0;
+}
+
+void DBFile::GetIndexKey (int index, OrderMaker &key) {
+    key.numAtts = 0;
+    if (myFilePtr != NULL){
+        myFilePtr->GetIndexKey(index,key);
+    }
+}
+
+int DBFile::GetNextFromIndex (int index, Record &fetchme, CNF &cnf, Record &literal) {
+    if (myFilePtr != NULL){
+        return myFilePtr->GetNextFromIndex(index,fetchme,cnf,literal);
+    }
+    return 0;
+}
+
 void DBFile::LoadPreference(char * newFilePath,fType f_type) {
     ifstream file;
     if (Utilities::checkfileExist(newFilePath)) {
@@ -863,7 +2798,7 @@ void DBFile::LoadPreference(char * newFilePath,fType f_type) {
         file.read((char*)&myPreference,sizeof(Preference));
         myPreference.preferenceFilePath = (char*)malloc(strlen(newFilePath) + 1);
         strcpy(myPreference.preferenceFilePath,newFilePath);
-        if (myPreference.f_type == sorted){
+        if (myPreference.f_type == sorted || myPreference.f_type == tree || myPreference.f_type == hashed){
 
         myPreference.orderMaker = new OrderMaker();
         file.read((char*)myPreference.orderMaker,sizeof(OrderMaker));
@@ -881,6 +2816,15 @@ void DBFile::LoadPreference(char * newFilePath,fType f_type) {
         myPreference.allRecordsWritten = true;
         myPreference.orderMaker = NULL;
         myPreference.runLength = 0;
+        myPreference.rootPage = -1;
+        myPreference.firstLeaf = -1;
+        myPreference.numSegments = 0;
+        myPreference.nextSegmentId = 0;
+        myPreference.compactionPolicy = tiered;
+        myPreference.hashLevel = 0;
+        myPreference.hashNext = 0;
+        myPreference.hashBytes = 0;
+        myPreference.numIndexes = 0;
     }
 }
 
@@ -892,7 +2836,7 @@ void DBFile::DumpPreference(){
         exit(1);
     }
     file.write((char*)&myPreference,sizeof(Preference));
-    if (myPreference.f_type == sorted){
+    if (myPreference.f_type == sorted || myPreference.f_type == tree || myPreference.f_type == hashed){
         file.write((char*)myPreference.orderMaker,sizeof(OrderMaker));
     }
     file.close();
@@ -5,6 +5,8 @@
 #include <stdlib.h>
 #include <iostream>
 #include <fstream>
+#include <vector>
+#include <map>
 #include "Defs.h"
 #include "TwoWayList.h"
 #include "Record.h"
@@ -14,15 +16,112 @@
 #include "ComparisonEngine.h"
 #include "BigQ.h"
 #include "Pipe.h"
+#include "FenceIndex.h"
 
-typedef enum {heap, sorted, tree,undefined} fType;
+typedef enum {heap, sorted, tree, hashed, undefined} fType;
 typedef enum {READ, WRITE,IDLE} BufferMode;
+typedef enum {tiered, leveled} CompactionPolicy;
 
+// most delta segments a sorted file keeps next to its base file
+#define MAX_SEGMENTS 32
+// number of segments merged at once (tiered) or size ratio between levels (leveled)
+#define COMPACTION_FANOUT 4
+
+// buckets a hash file starts with, the table then grows one bucket at a time
+#define HASH_INITIAL_BUCKETS 4
+// a bucket is split once the records would fill this percentage of a page in every bucket
+#define HASH_FILL_PERCENT 75
+// bytes of added records a hash file buffers before writing them to their buckets
+#define HASH_BUFFER_BYTES (4 * PAGE_SIZE)
+
+// most secondary indexes a heap file keeps
+#define MAX_INDEXES 4
+// bytes of index entries a heap file buffers before writing them to its indexes
+#define INDEX_BUFFER_BYTES (4 * PAGE_SIZE)
+
+// records the input pipe of a sorted file holds, so that AddBatch hands them to the sorter at once
+#define SORTED_INPUT_BUFFER 1024
+
+// startup of sorted, tree and hash files: the sort (or key) order and the run length used to sort input
 typedef struct {
     OrderMaker *o;
     int l;
+    // how sorted files compact their delta segments, tiered by default
+    CompactionPolicy policy;
 } SortedStartUp;
 
+// structure to encapsulate the address of a record in a heap file: the
+// page it is stored in and its position in that page
+typedef struct {
+    off_t page;
+    int slot;
+} RecordId;
+
+// structure to encapsulate a secondary index of a heap file. The index is a
+// tree file of entries made of the key attributes followed by the page and
+// slot of the record, named after the table and the index position.
+typedef struct {
+    // attributes of the table the index is on
+    OrderMaker key;
+    off_t rootPage;
+    off_t firstLeaf;
+} IndexInfo;
+
+// structure to encapsulate a delta segment of a sorted file: a sorted file
+// of its own, named after the table and the segment id
+typedef struct {
+    int id;
+    int level;
+    off_t pages;
+} SegmentInfo;
+
+// structure to encapsulate the read position in one segment of a sorted file
+typedef struct {
+    // the cursor opens its own file, so it keeps reading it even after a compaction replaced it
+    File * file;
+    Page * page;
+    off_t nextPage;
+    off_t totalPages;
+    // next record of the segment, NULL once it is exhausted
+    Record * head;
+    // false when the file is shared with the DBFile, it is then left open when the cursor closes
+    bool ownsFile;
+} SegmentCursor;
+
+// A cursor scans a file with a read position and page buffers of its own,
+// so that any number of cursors can read one open DBFile at the same time,
+// each on its own thread. A sorted file cursor opens the files it reads for
+// itself and keeps reading them even if a compaction replaces them; a heap
+// file cursor reads the file of the DBFile, up to its length when opened.
+class Cursor {
+    // one per file read: the heap file, or the base file and the segments of a sorted file
+    vector<SegmentCursor *> cursors;
+    // the records of a sorted file are merged on its sort order, NULL to read the files in turn
+    OrderMaker * order;
+    // file read next when the files are read in turn
+    int current;
+    ComparisonEngine compEng;
+public:
+    Cursor(OrderMaker * order);
+    ~Cursor();
+    //  function to add a file to read, closed with the cursor unless it is shared with the DBFile
+    void AddFile(File * file, bool shared);
+    void MoveFirst();
+    int GetNext(Record &fetchme);
+    int GetNext(Record &fetchme, CNF &cnf, Record &literal);
+};
+
+// structure to encapsulate a node of a tree file. A node is stored in one
+// page, as a header record (isLeaf, next) followed by its entries. Leaf
+// entries are the records themselves, internal entries are separators:
+// the sort attributes of the first record below a child and the child page.
+typedef struct {
+    bool isLeaf;
+    // next leaf in sort order, -1 for the last leaf and for internal nodes
+    off_t next;
+    vector<Record *> entries;
+} TreeNode;
+
 // class to take care of meta data for each table
 class Preference{
 public:
@@ -60,6 +159,26 @@ public:
     // Run Length For Sorting
     int runLength;
 
+    // Root node and first leaf of a tree file, -1 while the tree is empty
+    off_t rootPage;
+    off_t firstLeaf;
+
+    // Delta segments of a sorted file, oldest first, and how they are compacted
+    int numSegments;
+    int nextSegmentId;
+    SegmentInfo segments[MAX_SEGMENTS];
+    CompactionPolicy compactionPolicy;
+
+    // Linear hashing state of a hash file: buckets before hashNext are split
+    // into level hashLevel+1, and the bytes stored decide when to split next
+    int hashLevel;
+    int hashNext;
+    long long hashBytes;
+
+    // Secondary indexes of a heap file
+    int numIndexes;
+    IndexInfo indexes[MAX_INDEXES];
+
 };
 
 
@@ -73,6 +192,11 @@ protected:
     Preference * myPreferencePtr;
     //  Used to keep track of the state.
     ComparisonEngine myCompEng;
+    // record read by GetNextPage that did not fit the page, it starts the next one
+    Record pageOverflow;
+    bool hasPageOverflow;
+    //  function to read the rest of the buffered page, or else the next page of myFile, into fetchme
+    int ReadNextPage(Page &fetchme);
 public:
     GenericDBFile();
     int GetPageLocationToWrite();
@@ -85,45 +209,274 @@ public:
     virtual ~GenericDBFile();
     virtual void MoveFirst ();
     virtual void Add (Record &addme);
+    virtual void AddBatch (Record *addme, int numRecords);
+    virtual void AddBatch (Page &addme);
     virtual void Load (Schema &myschema, const char *loadpath);
     virtual int GetNext (Record &fetchme);
     virtual int GetNext (Record &fetchme, CNF &cnf, Record &literal);
+    virtual int GetNextPage (Page &fetchme);
+    virtual Cursor * OpenCursor ();
+    virtual File * GetPageFile (off_t &numPages);
     virtual int Close();
+    virtual int GetRecord (RecordId rid, Record &fetchme);
+    virtual RecordId GetRecordId ();
+    virtual int CreateIndex (OrderMaker &key);
+    virtual int GetNumIndexes ();
+    virtual void GetIndexKey (int index, OrderMaker &key);
+    virtual int GetNextFromIndex (int index, Record &fetchme, CNF &cnf, Record &literal);
+    virtual int GetSortOrder (OrderMaker &order);
 };
 
+class TreeDBFile;
+
+// Records of a heap file are addressed by (page, slot). Secondary indexes
+// map the key attributes of every record to its address; they are kept up
+// to date by Add, and a scan whose CNF pins a prefix of an index key with
+// equalities reads the matching entries and fetches only their records.
 class HeapDBFile: public virtual GenericDBFile{
+    // address of the record last added or read
+    RecordId currentId;
+    // records of the page last read by GetRecord, -1 when there is none
+    vector<Record *> fetchedRecords;
+    off_t fetchedPage;
+    // one tree file per index in the preference, opened on first use
+    vector<TreeDBFile *> indexFiles;
+    vector<Preference *> indexPreferences;
+    bool indexesOpen;
+    // entries added since the indexes were last written, one list per index
+    vector<vector<Record *> > indexBuffer;
+    int indexBufferBytes;
+    // index read by the current scan, -1 for a sequential scan
+    int probeIndex;
+    OrderMaker * probeOrder;
+    // true until the first record is read after MoveFirst
+    bool doProbe;
+
+    string GetIndexPath(int index);
+    void OpenIndexes();
+    void CloseIndexes();
+    //  function to write the buffered entries to their indexes, sorted so that each leaf is written once
+    void FlushIndexBuffer();
+    //  function to open the tree file of an index, created if create is set
+    void OpenIndex(int index, bool create);
+    //  function to get the page the buffered records are written to
+    off_t GetBufferPageLocation();
+    //  function to write the buffered records so that they can be read by address
+    void WriteBuffer();
+    //  function to switch the file to appending, with the last page of the file in the buffer
+    void StartWriting();
+    void MakeIndexEntry(Record &rec, OrderMaker &key, RecordId rid, Record &entry);
+    RecordId GetEntryId(Record &entry, int numKeys);
 public:
     HeapDBFile(Preference * preference);
     ~HeapDBFile();
     void MoveFirst ();
     void Add (Record &addme);
+    void AddBatch (Record *addme, int numRecords);
+    void AddBatch (Page &addme);
     void Load (Schema &myschema, const char *loadpath);
     int GetNext (Record &fetchme);
     int GetNext (Record &fetchme, CNF &cnf, Record &literal);
+    int GetNextPage (Page &fetchme);
+    Cursor * OpenCursor ();
+    File * GetPageFile (off_t &numPages);
     int Close ();
+    int GetRecord (RecordId rid, Record &fetchme);
+    RecordId GetRecordId ();
+    int CreateIndex (OrderMaker &key);
+    int GetNumIndexes ();
+    void GetIndexKey (int index, OrderMaker &key);
+    int GetNextFromIndex (int index, Record &fetchme, CNF &cnf, Record &literal);
 
 };
 
+// Records added to a sorted file are sorted by a BigQ and written as a delta
+// segment when the file switches to reading, so a batch of adds costs the
+// size of the batch and not of the table. Reads merge the base file with
+// all the segments. Segments are compacted into larger ones, and finally
+// into the base file, following the tiered or leveled policy. Compaction
+// runs on a background thread; a scan reads the files that made up the
+// table when it was opened, and the result of a compaction is swapped in
+// for the scans opened after it. Every file of the table is written
+// together with a narrow projection holding only the sort attributes, so
+// that a query reading only those never touches the records themselves.
 class SortedDBFile: public  GenericDBFile{
     Pipe * inputPipePtr;
     Pipe * outputPipePtr;
     BigQ * bigQPtr;
     File newFile;
     Page outputBufferForNewFile;
-    OrderMaker * queryOrderMaker;
+    // bounds of the current search on the sort order, see CNF::GetRangeOrderMakers
+    OrderMaker lowerBound;
+    OrderMaker upperBound;
     bool doBinarySearch;
+    // one cursor per segment and the base file while a merged scan is open
+    vector<SegmentCursor *> scanCursors;
+    bool scanOpen;
+    // guards the segment list, the base file swap and the compaction flags
+    pthread_mutex_t segmentMutex;
+    pthread_t compactionThread;
+    bool compactionRunning;
+    bool compactionStarted;
+    // set by the compaction when a new base file was renamed into place,
+    // myFile is reopened by the reading thread
+    bool baseReplaced;
+    // pages of the new base file until myFile is reopened, -1 otherwise
+    off_t basePages;
+    // first key of every page of the base file and of the segments, loaded on the first lookup
+    FenceIndex * baseFences;
+    map<int, FenceIndex *> segmentFences;
+    // sort order of the projected records: their attributes, in order
+    OrderMaker projectionOrder;
+    // one cursor per projection while an index-only scan is open
+    vector<SegmentCursor *> projectionCursors;
+    bool projectionOpen;
+    // true when a file has no projection, the records are then projected as they are read
+    bool projectRecords;
+
+    string GetSegmentPath(int id);
+    string GetBasePath();
+    //  function to get the path of the fences of a segment, or of the base file for id -1
+    string GetFencePath(int id);
+    //  function to get the path of the projection of a segment, or of the base file for id -1
+    string GetProjectionPath(int id);
+    off_t GetBasePages();
+    //  function to get the fences of a file, called with segmentMutex held
+    FenceIndex * GetFences(File &file, int id);
+    //  function to append a record to a sorted file being written, keeping its fences
+    void AppendSorted(File &file, Page &page, off_t &pages, Record &rec, FenceIndex &fences);
+    //  function to append the sort attributes of a record to the projection of a file being written
+    void AppendProjection(File &file, Page &page, off_t &pages, Record &rec);
+    void OpenProjectionScan();
+    void CloseProjectionScan();
+    //  function to open cursors over the base file and the segments, at the lower bound in literal if given
+    void OpenScan(Record * literal);
+    void CloseScan();
+    //  function to write the records sorted by the BigQ as a new level 0 segment
+    void FlushInputToSegment();
+    //  function to merge the segments with the given ids, and the base file if intoBase
+    void MergeSegments(vector<int> &ids, bool intoBase, int level);
+    //  function to choose the next merge of the compaction policy, called with segmentMutex held
+    bool PickCompaction(vector<int> &ids, bool &intoBase, int &level);
+    static void * CompactionWorker(void * arg);
+    void StartCompaction();
+    void WaitForCompaction();
+    //  function to reopen myFile after the compaction replaced the base file
+    void SyncBaseFile();
+    void ReopenBaseFile();
+    bool HasSegments();
+    //  function to start the BigQ the added records are sorted by, and switch the file to writing
+    void StartWriting();
     
 public:
     SortedDBFile(Preference * preference);
     ~SortedDBFile();
     void MoveFirst ();
     void Add (Record &addme);
+    void AddBatch (Record *addme, int numRecords);
+    void AddBatch (Page &addme);
+    void Load (Schema &myschema, const char *loadpath);
+    int GetNext (Record &fetchme);
+    int GetNext (Record &fetchme, CNF &cnf, Record &literal);
+    int GetNextPage (Page &fetchme);
+    Cursor * OpenCursor ();
+    int Close ();
+    int GetNumIndexes ();
+    void GetIndexKey (int index, OrderMaker &key);
+    int GetNextFromIndex (int index, Record &fetchme, CNF &cnf, Record &literal);
+    int GetSortOrder (OrderMaker &order);
+};
+
+class TreeDBFile: public GenericDBFile{
+    // sort order of the separators: their first attributes, in order
+    OrderMaker keyOrderMaker;
+    // bounds of the current search on the key, see CNF::GetRangeOrderMakers
+    OrderMaker lowerBound;
+    OrderMaker upperBound;
+    // true until the first record is read after MoveFirst
+    bool doSeek;
+    // leaf to read once myPage is exhausted, -1 after the last leaf
+    off_t nextLeaf;
+
+    void ReadNode(off_t whichPage, TreeNode &node);
+    void WriteNode(off_t whichPage, TreeNode &node);
+    void FreeNode(TreeNode &node);
+    int NodeBytes(TreeNode &node);
+    //  function to build the separator pointing to child from the sort attributes of a record or separator
+    void MakeSeparator(Record &from, OrderMaker &fromOrder, off_t child, Record &separator);
+    off_t GetChild(Record *separator);
+    //  function to insert rec below the node, fills separator and returns true if the node split
+    bool InsertInto(off_t whichPage, Record &rec, Record &separator);
+    //  function to split a full node, the right half goes to a new page
+    void SplitNode(off_t whichPage, TreeNode &node, Record &separator);
+    //  function to insert the sorted records low to high below the node, fills separators with the new siblings
+    void InsertRange(off_t whichPage, vector<Record *> &recs, int low, int high, vector<Record *> &separators);
+    //  function to write a node over as many pages as it needs, fills separators with the pages after the first
+    void WriteSplit(off_t whichPage, TreeNode &node, vector<Record *> &separators);
+    //  function to build the tree bottom up from sorted records
+    void BulkLoad(Pipe &sortedInput);
+    //  function to position the scan at the first record not smaller than literal
+    void SeekTo(Record &literal, OrderMaker &queryOrder);
+public:
+    TreeDBFile(Preference * preference);
+    ~TreeDBFile();
+    void MoveFirst ();
+    void Add (Record &addme);
+    void Load (Schema &myschema, const char *loadpath);
+    int GetNext (Record &fetchme);
+    int GetNext (Record &fetchme, CNF &cnf, Record &literal);
+    int Close ();
+    int GetSortOrder (OrderMaker &order);
+    //  function to insert a record, only the pages on its path are rewritten
+    void Insert(Record &rec);
+    //  function to insert records sorted on the key, every node on their paths is rewritten once
+    void InsertBatch(vector<Record *> &recs);
+    //  function to add records sorted on the key, an empty tree is built bottom up
+    void AddSorted(Pipe &sortedInput);
+    //  function to get the next record whose key starts with the queryOrder attributes of literal
+    int GetNextMatch(Record &fetchme, OrderMaker &queryOrder, Record &literal);
+};
+
+// Records of a hash file are spread over buckets by a hash of their key
+// attributes, with linear hashing: buckets are split one at a time, in
+// order, as the file grows. A bucket is a chain of pages; the chains are
+// kept in <table>.dir. A lookup that pins every key attribute with an
+// equality reads only its bucket.
+class HashDBFile: public GenericDBFile{
+    // pages of every bucket in chain order, and pages left over by splits
+    vector<vector<off_t> > bucketPages;
+    vector<off_t> freePages;
+    off_t allocatedPages;
+    bool directoryLoaded;
+    // added records not yet written to their bucket
+    vector<Record *> insertBuffer;
+    int bufferedBytes;
+    // scan position: the bucket, the page of its chain to read next and the bucket to stop at
+    int scanBucket;
+    int scanPage;
+    int scanEnd;
+    // true until the first record is read after MoveFirst
+    bool doProbe;
+
+    string GetDirectoryPath();
+    void LoadDirectory();
+    void WriteDirectory();
+    int GetBucket(unsigned long hash);
+    off_t AllocatePage();
+    //  function to append records after the last page of a bucket, they are consumed
+    void AppendToBucket(int bucket, vector<Record *> &records);
+    void FlushInsertBuffer();
+    //  function to split bucket hashNext into itself and a new last bucket
+    void SplitBucket();
+public:
+    HashDBFile(Preference * preference);
+    ~HashDBFile();
+    void MoveFirst ();
+    void Add (Record &addme);
     void Load (Schema &myschema, const char *loadpath);
     int GetNext (Record &fetchme);
     int GetNext (Record &fetchme, CNF &cnf, Record &literal);
     int Close ();
-    void MergeSortedInputWithFile();
-    int BinarySearch(Record &fetchme, Record &literal,off_t low, off_t high);
 };
 
 
@@ -179,6 +532,15 @@ public:
 	**/
 	void Add (Record &addme);
 
+	/**
+		AddBatch adds many records in one call, either numRecords records
+		from an array or every record of a page built by the caller. Like
+		Add, the records are consumed. A heap file writes full pages to
+		disk directly, a sorted file hands the whole batch to its sorter.
+	**/
+	void AddBatch (Record *addme, int numRecords);
+	void AddBatch (Page &addme);
+
 	/**
 		The first version of GetNext simply gets
 		the next record from the file and returns it to the user,
@@ -202,6 +564,35 @@ public:
 	**/
 	int GetNext (Record &fetchme, CNF &cnf, Record &literal);
 
+	/**
+		GetNextPage puts the next page of records into fetchme, replacing
+		what was there, and moves the pointer past them; Page::GetRecords
+		then gives them without moving them out of the page. Heap and
+		sorted files hand over the pages read from disk as they are, other
+		files fill the page with records in GetNext order. The return
+		value is zero if and only if there are no more records.
+	**/
+	int GetNextPage (Page &fetchme);
+
+	/**
+		OpenCursor gives a new scan of a heap or sorted file, positioned
+		at its first record, that does not move the pointer of the DBFile
+		or of any other cursor. Cursors may be used from different threads
+		while the file is not written to. Records added after the cursor
+		was opened are not seen. The caller deletes the cursor before
+		closing the file.
+	**/
+	Cursor * OpenCursor ();
+
+	/**
+		GetPageFile gives the File holding the records of a heap file and
+		sets numPages to its number of pages, after writing the records
+		still buffered by Add. Its pages can then be read directly with
+		File::GetPage, from several threads at once, while the file is not
+		written to. Returns NULL for the other file types.
+	**/
+	File * GetPageFile (off_t &numPages);
+
 	/**
 		Next, there is a function that is used to actually create the file,
 		called Create. The first parameter to this function is a text string
@@ -236,5 +627,40 @@ public:
 		Next, Close simply closes the file. The return value is a 1 on success and a zero on failure.
 	**/
     int Close ();
+
+	/**
+		Records of a heap file can also be read by address. GetRecordId gives
+		the address of the record last added or returned by GetNext, and
+		GetRecord reads the record at an address. GetRecord returns zero if
+		there is no record at that address.
+	**/
+	int GetRecord (RecordId rid, Record &fetchme);
+	RecordId GetRecordId ();
+
+	/**
+		CreateIndex adds a secondary index on the key attributes to a heap
+		file and fills it with the records already in the file. The index is
+		kept up to date by Add and Load, and is used by GetNext with a CNF
+		that compares a prefix of the key for equality. Returns 1 on success.
+	**/
+	int CreateIndex (OrderMaker &key);
+
+	/**
+		Index-only scans. A heap file has one index per CreateIndex, a sorted
+		file has a single one on its sort order. GetIndexKey gives the
+		attributes of an index, and GetNextFromIndex returns records made of
+		exactly those attributes, in key order, read from the index alone.
+		The CNF is over that narrow schema. MoveFirst restarts the scan.
+	**/
+	int GetNumIndexes ();
+	void GetIndexKey (int index, OrderMaker &key);
+	int GetNextFromIndex (int index, Record &fetchme, CNF &cnf, Record &literal);
+
+	/**
+		GetSortOrder gives the order in which GetNext returns the records of
+		a sorted or B+-tree file, with or without a CNF, and returns 1. It
+		returns 0 for the other file types, whose records come in no order.
+	**/
+	int GetSortOrder (OrderMaker &order);
 };
 #endif
\ No newline at end of file
@@ -0,0 +1,115 @@
+#include "FenceIndex.h"
+#include <stdio.h>
+
+// ------------------------------------------------------------------
+FenceIndex :: FenceIndex(OrderMaker &sortOrder){
+    this->sortOrder = sortOrder;
+    fenceOrder.numAtts = sortOrder.numAtts;
+    for(int i = 0; i < sortOrder.numAtts; i++){
+        fenceOrder.whichAtts[i] = i;
+        fenceOrder.whichTypes[i] = sortOrder.whichTypes[i];
+    }
+}
+
+FenceIndex :: ~FenceIndex(){
+    Clear();
+}
+
+void FenceIndex :: Clear(){
+    for(int i = 0; i < fences.size(); i++){
+        delete fences[i];
+    }
+    fences.clear();
+}
+
+int FenceIndex :: GetNumPages(){
+    return fences.size();
+}
+
+void FenceIndex :: AddPage(Record &firstRecord){
+    Record * fence = new Record();
+    fence->Copy(&firstRecord);
+    int numAtts = ((int *) fence->bits)[1] / sizeof(int) - 1;
+    fence->Project(sortOrder.whichAtts, sortOrder.numAtts, numAtts);
+    fences.push_back(fence);
+}
+
+off_t FenceIndex :: LowerBoundPage(Record &literal, OrderMaker &queryOrder){
+    // equal records may start on the page before the first page whose fence is equal
+    off_t low = 0;
+    off_t high = (off_t) fences.size()-1;
+    off_t result = 0;
+    while(low <= high){
+        off_t mid = low + (high - low)/2;
+        if(comparisonEngine.Compare(&literal, &queryOrder, fences[mid], &fenceOrder) > 0){
+            result = mid;
+            low = mid+1;
+        }
+        else{
+            high = mid-1;
+        }
+    }
+    return result;
+}
+
+void FenceIndex :: Build(File &file){
+    Clear();
+    Page page;
+    Record first;
+    for(off_t i = 0; i < file.GetLength()-1; i++){
+        file.GetPage(&page,i);
+        page.GetFirst(&first);
+        AddPage(first);
+    }
+}
+
+int FenceIndex :: Write(const char *fencePath){
+    FILE * fenceFile = fopen(fencePath,"wb");
+    if(fenceFile == NULL){
+        cerr << "Error in opening fence file " << fencePath << " for writing.." << endl;
+        return 0;
+    }
+    int numFences = fences.size();
+    fwrite(&numFences,sizeof(int),1,fenceFile);
+    // a fence is written as its bits, which start with their length
+    for(int i = 0; i < numFences; i++){
+        fwrite(fences[i]->bits,1,((int *) fences[i]->bits)[0],fenceFile);
+    }
+    fclose(fenceFile);
+    return 1;
+}
+
+int FenceIndex :: Read(const char *fencePath){
+    FILE * fenceFile = fopen(fencePath,"rb");
+    if(fenceFile == NULL){
+        return 0;
+    }
+    Clear();
+    int numFences = 0;
+    if(fread(&numFences,sizeof(int),1,fenceFile) != 1){
+        fclose(fenceFile);
+        return 0;
+    }
+    for(int i = 0; i < numFences; i++){
+        int length;
+        if(fread(&length,sizeof(int),1,fenceFile) != 1){
+            Clear();
+            fclose(fenceFile);
+            return 0;
+        }
+        char * bits = new char[length];
+        ((int *) bits)[0] = length;
+        if(fread(bits+sizeof(int),1,length-sizeof(int),fenceFile) != length-sizeof(int)){
+            delete [] bits;
+            Clear();
+            fclose(fenceFile);
+            return 0;
+        }
+        Record * fence = new Record();
+        fence->bits = bits;
+        fences.push_back(fence);
+    }
+    fclose(fenceFile);
+    return 1;
+}
+// ------------------------------------------------------------------
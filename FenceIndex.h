@@ -0,0 +1,44 @@
+#ifndef FENCE_INDEX_H
+#define FENCE_INDEX_H
+
+#include <vector>
+#include <iostream>
+#include "Record.h"
+#include "File.h"
+#include "Comparison.h"
+#include "ComparisonEngine.h"
+using namespace std;
+
+// ------------------------------------------------------------------
+// Class to keep the first key of every page of a sorted file in memory.
+// A fence is the sort attributes of the first record of a page, in sort
+// order, so a lookup is a binary search over the fences followed by a
+// single page read instead of a page read at every probe. The fences
+// are written when the file is, and saved next to the .pref.
+class FenceIndex {
+    // sort order of the data file
+    OrderMaker sortOrder;
+    // the same attributes as they are numbered inside a fence
+    OrderMaker fenceOrder;
+    vector<Record *> fences;
+    ComparisonEngine comparisonEngine;
+public:
+    FenceIndex(OrderMaker &sortOrder);
+    ~FenceIndex();
+    void Clear();
+    int GetNumPages();
+    //      function to add the fence of the next page, from the first record of the page
+    void AddPage(Record &firstRecord);
+    //      function to find the last page whose fence is smaller than literal,
+    //      or page 0 if there is none. queryOrder picks the literal attributes
+    //      to compare with a prefix of the sort order, as the lower bound given
+    //      by CNF::GetRangeOrderMakers does.
+    off_t LowerBoundPage(Record &literal, OrderMaker &queryOrder);
+    //      function to build the fences of an existing file, one page read per page
+    void Build(File &file);
+    //      functions to save and load the fences, return 0 on failure
+    int Write(const char *fencePath);
+    int Read(const char *fencePath);
+};
+// ------------------------------------------------------------------
+#endif
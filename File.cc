@@ -154,10 +154,24 @@ void Page :: FromBinary (char *bits) {
 	delete temp;
 }
 
+void Page :: GetRecords (vector<Record *> &records) {
+
+	records.clear ();
+	myRecs->MoveToStart ();
+	for (int i = 0; i < numRecs; i++) {
+		records.push_back (myRecs->Current (0));
+		myRecs->Advance ();
+	}
+}
+
 int Page :: getNumRecs() {
 	return this->numRecs;
 }
 
+int Page :: getCurSizeInBytes() {
+	return this->curSizeInBytes;
+}
+
 File :: File () {
 }
 
@@ -185,14 +199,26 @@ void File :: GetPage (Page *putItHere, off_t whichPage) {
 		exit(1);
 	}
 
-	lseek (myFilDes, PAGE_SIZE * whichPage, SEEK_SET);
-	read (myFilDes, bits, PAGE_SIZE);
+	// pread leaves the file offset alone, so that many threads can read pages at once
+	pread (myFilDes, bits, PAGE_SIZE, PAGE_SIZE * whichPage);
 	putItHere->FromBinary (bits);
 	delete [] bits;
 	
 }
 
 
+void File :: ReadAhead (off_t firstPage, off_t numPages) {
+
+	// this is because the first page has no data
+	firstPage++;
+
+	if (firstPage >= curLength || numPages <= 0) {
+		return;
+	}
+	posix_fadvise (myFilDes, PAGE_SIZE * firstPage, PAGE_SIZE * numPages, POSIX_FADV_WILLNEED);
+}
+
+
 void File :: AddPage (Page *addMe, off_t whichPage) {
 //	cout<<"Writing Page"<<" Which Page: "<<whichPage<<" Cur Length : "<<curLength<<endl;
 	// this is because the first page has no data
@@ -1,6 +1,7 @@
 #ifndef FILE_H
 #define FILE_H
 
+#include <vector>
 #include "TwoWayList.h"
 #include "Record.h"
 #include "Schema.h"
@@ -44,6 +45,9 @@ public:
 
 	// getter and setter method for page
 	int getNumRecs();
+
+	// size in bytes of the binary representation of the page
+	int getCurSizeInBytes();
 	
 	// this takes a page and writes its binary representation to bits
 	void ToBinary (char *bits);
@@ -64,6 +68,11 @@ public:
 	// empty it out
 	void EmptyItOut ();
 
+	// this fills records with the records of the page, in order, without
+	// removing them; they still belong to the page and are only valid
+	// until the page is changed
+	void GetRecords (vector<Record *> &records);
+
 };
 
 
@@ -88,9 +97,14 @@ public:
 	// simply opened
 	void Open (int length, char *fName);
 
-	// allows someone to explicitly get a specified page from the file
+	// allows someone to explicitly get a specified page from the file;
+	// several threads may get pages at once as long as none is added
 	void GetPage (Page *putItHere, off_t whichPage);
 
+	// asks the OS to start reading numPages pages from firstPage in the
+	// background, so that the GetPage calls that follow do not wait
+	void ReadAhead (off_t firstPage, off_t numPages);
+
 	// allows someone to explicitly write a specified page to the file
 	// if the write is past the end of the file, all of the new pages that
 	// are before the page to be written are zeroed out
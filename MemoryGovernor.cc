@@ -0,0 +1,119 @@
+#include "MemoryGovernor.h"
+
+// ------------------------------------------------------------------
+MemoryGovernor :: MemoryGovernor(long long budget){
+    this->budget = budget;
+    this->inUse = 0;
+    this->peak = 0;
+    pthread_mutex_init(&governorMutex, NULL);
+}
+
+MemoryGovernor :: ~MemoryGovernor(){
+    pthread_mutex_destroy(&governorMutex);
+}
+
+int MemoryGovernor :: Register(double cost){
+    pthread_mutex_lock(&governorMutex);
+    MemoryAccount account;
+    account.cost = cost > 0 ? cost : 1;
+    account.share = 0;
+    account.held = 0;
+    account.peak = 0;
+    accounts.push_back(account);
+    int operatorId = accounts.size()-1;
+    pthread_mutex_unlock(&governorMutex);
+    Distribute();
+    return operatorId;
+}
+
+void MemoryGovernor :: Distribute(){
+    pthread_mutex_lock(&governorMutex);
+    double totalCost = 0;
+    for(vector<MemoryAccount>::iterator i = accounts.begin() ; i!=accounts.end() ; ++i){
+        totalCost += i->cost;
+    }
+    for(vector<MemoryAccount>::iterator i = accounts.begin() ; i!=accounts.end() ; ++i){
+        i->share = (long long) (budget * (i->cost / totalCost));
+    }
+    pthread_mutex_unlock(&governorMutex);
+}
+
+long long MemoryGovernor :: GetShare(int operatorId){
+    pthread_mutex_lock(&governorMutex);
+    long long share = accounts.at(operatorId).share;
+    pthread_mutex_unlock(&governorMutex);
+    return share;
+}
+
+long long MemoryGovernor :: ReservedForOthers(int operatorId){
+    long long reserved = 0;
+    for(int i = 0; i < accounts.size(); i++){
+        if(i != operatorId && accounts[i].share > accounts[i].held){
+            reserved += accounts[i].share - accounts[i].held;
+        }
+    }
+    return reserved;
+}
+
+long long MemoryGovernor :: Acquire(int operatorId, long long bytes, long long minimum){
+    pthread_mutex_lock(&governorMutex);
+    MemoryAccount &account = accounts.at(operatorId);
+    long long available = budget - inUse - ReservedForOthers(operatorId);
+    long long granted = bytes < available ? bytes : available;
+    // an operator can not make progress without its minimum, so it is
+    // granted even if that overshoots the budget; the peak will show it
+    if(granted < minimum){
+        granted = minimum;
+    }
+    account.held += granted;
+    if(account.held > account.peak){
+        account.peak = account.held;
+    }
+    inUse += granted;
+    if(inUse > peak){
+        peak = inUse;
+    }
+    pthread_mutex_unlock(&governorMutex);
+    return granted;
+}
+
+void MemoryGovernor :: Release(int operatorId, long long bytes){
+    pthread_mutex_lock(&governorMutex);
+    MemoryAccount &account = accounts.at(operatorId);
+    if(bytes > account.held){
+        bytes = account.held;
+    }
+    account.held -= bytes;
+    inUse -= bytes;
+    pthread_mutex_unlock(&governorMutex);
+}
+
+long long MemoryGovernor :: GetBudget(){
+    return budget;
+}
+
+long long MemoryGovernor :: GetUsage(){
+    pthread_mutex_lock(&governorMutex);
+    long long usage = inUse;
+    pthread_mutex_unlock(&governorMutex);
+    return usage;
+}
+
+long long MemoryGovernor :: GetPeakUsage(){
+    pthread_mutex_lock(&governorMutex);
+    long long peakUsage = peak;
+    pthread_mutex_unlock(&governorMutex);
+    return peakUsage;
+}
+
+void MemoryGovernor :: Print(){
+    pthread_mutex_lock(&governorMutex);
+    cout << "Memory Budget : " << budget << " bytes, in use : " << inUse
+         << " bytes, peak : " << peak << " bytes" << endl;
+    for(int i = 0; i < accounts.size(); i++){
+        cout << "  Operator " << i << " : cost " << accounts[i].cost << ", share "
+             << accounts[i].share << " bytes, peak " << accounts[i].peak << " bytes" << endl;
+    }
+    pthread_mutex_unlock(&governorMutex);
+}
+// ------------------------------------------------------------------
@@ -0,0 +1,59 @@
+#ifndef MEMORY_GOVERNOR_H
+#define MEMORY_GOVERNOR_H
+
+#include <pthread.h>
+#include <vector>
+#include <iostream>
+using namespace std;
+
+// ------------------------------------------------------------------
+// structure to encapsulate the memory bookkeeping of one operator
+typedef struct {
+    // estimated plan cost, used to split the budget
+    double cost;
+    // bytes the operator is entitled to
+    long long share;
+    // bytes the operator currently holds
+    long long held;
+    // most bytes the operator ever held
+    long long peak;
+} MemoryAccount;
+// ------------------------------------------------------------------
+
+// ------------------------------------------------------------------
+// Class used to share one memory budget (in bytes) between all the
+// operators of a query. The planner registers every memory hungry
+// operator with its estimated cost and the budget is split in proportion
+// to those costs. At run time operators acquire and release bytes; an
+// operator always gets its own share and may borrow whatever is not
+// promised to the others.
+class MemoryGovernor {
+    long long budget;
+    long long inUse;
+    long long peak;
+    vector<MemoryAccount> accounts;
+    pthread_mutex_t governorMutex;
+    // bytes promised to operators other than operatorId but not yet held
+    long long ReservedForOthers(int operatorId);
+public:
+    MemoryGovernor(long long budget);
+    ~MemoryGovernor();
+    //      function to register an operator, returns the id to use with it
+    int Register(double cost);
+    //      function to split the budget across the registered operators by cost
+    void Distribute();
+    //      function to get the share of the budget given to an operator
+    long long GetShare(int operatorId);
+    //      function to ask for bytes, at least minimum bytes are always granted.
+    //      Returns the number of bytes granted.
+    long long Acquire(int operatorId, long long bytes, long long minimum);
+    //      function to give bytes back
+    void Release(int operatorId, long long bytes);
+    long long GetBudget();
+    long long GetUsage();
+    long long GetPeakUsage();
+    //      function to print the budget, the shares and the peak memory
+    void Print();
+};
+// ------------------------------------------------------------------
+#endif
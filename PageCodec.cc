@@ -0,0 +1,157 @@
+#include "PageCodec.h"
+#include <string.h>
+
+// shortest back reference worth encoding
+#define MIN_MATCH 4
+// number of trailing bytes always emitted as literals
+#define LAST_LITERALS 5
+// size of the match finder hash table (in bits)
+#define HASH_BITS 12
+// largest distance a back reference can point to
+#define MAX_OFFSET 65535
+
+// hashes the 4 bytes found at p into the match finder table
+static unsigned int HashBytes (const unsigned char *p) {
+    unsigned int v;
+    memcpy (&v, p, sizeof (unsigned int));
+    return (v * 2654435761u) >> (32 - HASH_BITS);
+}
+
+// writes the overflow of a length that did not fit into its token nibble
+static unsigned char * WriteLength (unsigned char *op, int len) {
+    len -= 15;
+    while (len >= 255) {
+        *op++ = 255;
+        len -= 255;
+    }
+    *op++ = (unsigned char) len;
+    return op;
+}
+
+// writes a token, its literals and (if matchLen is non zero) a back reference
+static unsigned char * WriteSequence (unsigned char *op, const unsigned char *literals, int litLen, int offset, int matchLen) {
+    unsigned char *token = op++;
+    *token = (unsigned char) ((litLen < 15 ? litLen : 15) << 4);
+    if (litLen >= 15) {
+        op = WriteLength (op, litLen);
+    }
+    memcpy (op, literals, litLen);
+    op += litLen;
+
+    // the last sequence of a block carries only literals
+    if (matchLen == 0) {
+        return op;
+    }
+    *op++ = (unsigned char) (offset & 0xff);
+    *op++ = (unsigned char) (offset >> 8);
+    matchLen -= MIN_MATCH;
+    *token |= (unsigned char) (matchLen < 15 ? matchLen : 15);
+    if (matchLen >= 15) {
+        op = WriteLength (op, matchLen);
+    }
+    return op;
+}
+
+int PageCodec :: MaxCompressedLength (int srcLen) {
+    return srcLen + srcLen / 255 + 16;
+}
+
+int PageCodec :: Compress (const char *src, int srcLen, char *dst) {
+    const unsigned char *in = (const unsigned char *) src;
+    unsigned char *op = (unsigned char *) dst;
+
+    int table[1 << HASH_BITS];
+    for (int i = 0; i < (1 << HASH_BITS); i++) {
+        table[i] = -1;
+    }
+
+    int ip = 0;
+    int anchor = 0;
+    int limit = srcLen - LAST_LITERALS;
+    while (ip + MIN_MATCH <= limit) {
+        unsigned int h = HashBytes (in + ip);
+        int ref = table[h];
+        table[h] = ip;
+
+        if (ref >= 0 && ip - ref <= MAX_OFFSET && memcmp (in + ref, in + ip, MIN_MATCH) == 0) {
+            // extend the match as far as it goes
+            int len = MIN_MATCH;
+            while (ip + len < limit && in[ref + len] == in[ip + len]) {
+                len++;
+            }
+            op = WriteSequence (op, in + anchor, ip - anchor, ip - ref, len);
+            ip += len;
+            anchor = ip;
+        }
+        else {
+            ip++;
+        }
+    }
+
+    // flush whatever is left as literals
+    op = WriteSequence (op, in + anchor, srcLen - anchor, 0, 0);
+    return op - (unsigned char *) dst;
+}
+
+int PageCodec :: Decompress (const char *src, int srcLen, char *dst, int dstCapacity) {
+    const unsigned char *ip = (const unsigned char *) src;
+    const unsigned char *end = ip + srcLen;
+    unsigned char *op = (unsigned char *) dst;
+    unsigned char *opEnd = op + dstCapacity;
+
+    while (ip < end) {
+        int token = *ip++;
+
+        // copy the literals
+        int litLen = token >> 4;
+        if (litLen == 15) {
+            int s;
+            do {
+                if (ip >= end) {
+                    return -1;
+                }
+                s = *ip++;
+                litLen += s;
+            } while (s == 255);
+        }
+        if (ip + litLen > end || op + litLen > opEnd) {
+            return -1;
+        }
+        memcpy (op, ip, litLen);
+        ip += litLen;
+        op += litLen;
+
+        // the final sequence has no back reference
+        if (ip == end) {
+            break;
+        }
+
+        // copy the back reference, byte by byte as it may overlap
+        if (ip + 2 > end) {
+            return -1;
+        }
+        int offset = ip[0] | (ip[1] << 8);
+        ip += 2;
+        int matchLen = token & 15;
+        if (matchLen == 15) {
+            int s;
+            do {
+                if (ip >= end) {
+                    return -1;
+                }
+                s = *ip++;
+                matchLen += s;
+            } while (s == 255);
+        }
+        matchLen += MIN_MATCH;
+        if (offset == 0 || offset > op - (unsigned char *) dst || op + matchLen > opEnd) {
+            return -1;
+        }
+        const unsigned char *ref = op - offset;
+        for (int i = 0; i < matchLen; i++) {
+            op[i] = ref[i];
+        }
+        op += matchLen;
+    }
+    return op - (unsigned char *) dst;
+}
@@ -0,0 +1,27 @@
+#ifndef PAGE_CODEC_H
+#define PAGE_CODEC_H
+
+/**
+ *  class implementing a small LZ77 style codec used to compress the binary
+ *  image of a page before it is spilled to disk. The format is a sequence of
+ *  tokens; every token holds a run of literal bytes followed by a back
+ *  reference (offset, length) into the already decoded output. The last token
+ *  of a block only carries literals.
+**/
+class PageCodec {
+
+    public:
+
+        // worst case size of the compressed image of srcLen bytes.
+        static int MaxCompressedLength (int srcLen);
+
+        // compresses srcLen bytes from src into dst, dst must have room for
+        // MaxCompressedLength(srcLen) bytes. Returns the compressed size.
+        static int Compress (const char *src, int srcLen, char *dst);
+
+        // decompresses srcLen bytes from src into dst which can hold dstCapacity
+        // bytes. Returns the decompressed size or -1 if the input is corrupt.
+        static int Decompress (const char *src, int srcLen, char *dst, int dstCapacity);
+};
+
+#endif
@@ -0,0 +1,106 @@
+#include "ParallelScan.h"
+#include <unistd.h>
+
+// ------------------------------------------------------------------
+ParallelScan :: ParallelScan(DBFile &inFile, Pipe &out, CNF &cnf, Record &literal, int numWorkers){
+    this->inFile = &inFile;
+    this->out = &out;
+    this->cnf = &cnf;
+    this->literal = &literal;
+    joined = false;
+    pageFile = inFile.GetPageFile(numPages);
+    nextPage = 0;
+    if(numWorkers <= 0){
+        numWorkers = sysconf(_SC_NPROCESSORS_ONLN);
+    }
+    // no more workers than morsels, and GetNext is not shared between threads
+    long long numMorsels = (numPages + MORSEL_PAGES - 1) / MORSEL_PAGES;
+    if(pageFile == NULL || numMorsels < 1){
+        numWorkers = 1;
+    }
+    else if(numWorkers > numMorsels){
+        numWorkers = numMorsels;
+    }
+    running = numWorkers;
+    workers.resize(numWorkers);
+    for(int i = 0; i < numWorkers; i++){
+        pthread_create(&workers[i], NULL, ParallelScan::Worker, this);
+    }
+}
+
+ParallelScan :: ~ParallelScan(){
+    WaitUntilDone();
+}
+
+void ParallelScan :: WaitUntilDone(){
+    if(!joined){
+        for(int i = 0; i < workers.size(); i++){
+            pthread_join(workers[i], NULL);
+        }
+        joined = true;
+    }
+}
+
+void * ParallelScan :: Worker(void * arg){
+    ParallelScan * scan = (ParallelScan *) arg;
+    if(scan->pageFile != NULL){
+        scan->ScanMorsels();
+    }
+    else{
+        scan->ScanFile();
+    }
+    if(--scan->running == 0){
+        scan->out->ShutDown();
+    }
+    return NULL;
+}
+
+void ParallelScan :: ScanMorsels(){
+    Page page;
+    Record rec;
+    ComparisonEngine comparisonEngine;
+    Record * batch = new Record[SCAN_BATCH];
+    int batchSize = 0;
+    while(true){
+        long long first = nextPage.fetch_add(MORSEL_PAGES);
+        if(first >= numPages){
+            break;
+        }
+        long long last = min(first + MORSEL_PAGES, (long long) numPages);
+        for(long long whichPage = first; whichPage < last; whichPage++){
+            pageFile->GetPage(&page, whichPage);
+            while(page.GetFirst(&rec)){
+                if(!comparisonEngine.Compare(&rec, literal, cnf)){
+                    continue;
+                }
+                batch[batchSize++].Consume(&rec);
+                if(batchSize == SCAN_BATCH){
+                    out->Insert(batch, batchSize);
+                    batchSize = 0;
+                }
+            }
+        }
+    }
+    if(batchSize > 0){
+        out->Insert(batch, batchSize);
+    }
+    delete [] batch;
+}
+
+void ParallelScan :: ScanFile(){
+    Record * batch = new Record[SCAN_BATCH];
+    int batchSize = 0;
+    inFile->MoveFirst();
+    while(inFile->GetNext(batch[batchSize], *cnf, *literal)){
+        batchSize++;
+        if(batchSize == SCAN_BATCH){
+            out->Insert(batch, batchSize);
+            batchSize = 0;
+        }
+    }
+    if(batchSize > 0){
+        out->Insert(batch, batchSize);
+    }
+    delete [] batch;
+}
+// ------------------------------------------------------------------
@@ -0,0 +1,54 @@
+#ifndef PARALLEL_SCAN_H
+#define PARALLEL_SCAN_H
+
+#include <pthread.h>
+#include <atomic>
+#include <vector>
+#include "Pipe.h"
+#include "File.h"
+#include "Record.h"
+#include "Comparison.h"
+#include "ComparisonEngine.h"
+#include "DBFile.h"
+using namespace std;
+
+// pages a worker claims at once
+#define MORSEL_PAGES 4
+// matching records a worker collects before pushing them into the pipe
+#define SCAN_BATCH 256
+
+// ------------------------------------------------------------------
+// Class to scan a heap file with the CNF on several threads. The page
+// range of the file is cut into morsels of MORSEL_PAGES pages; every
+// worker claims the next morsel from a shared counter, reads its pages
+// with a page buffer of its own, and pushes the matching records into
+// the out pipe in batches. Records come out in no particular order. The
+// pipe is shut down once the last worker is done. A file that can not be
+// read page by page is scanned with GetNext by a single worker.
+class ParallelScan {
+    DBFile * inFile;
+    Pipe * out;
+    CNF * cnf;
+    Record * literal;
+    // file holding the pages, NULL to scan with GetNext
+    File * pageFile;
+    off_t numPages;
+    // first page of the next morsel
+    atomic<long long> nextPage;
+    // workers still running, the last one shuts the pipe down
+    atomic<int> running;
+    vector<pthread_t> workers;
+    bool joined;
+    static void * Worker(void * arg);
+    //      function to scan morsels until there are none left
+    void ScanMorsels();
+    //      function to scan the whole file with GetNext
+    void ScanFile();
+public:
+    //      starts the workers; numWorkers <= 0 uses one per core
+    ParallelScan(DBFile &inFile, Pipe &out, CNF &cnf, Record &literal, int numWorkers);
+    ~ParallelScan();
+    void WaitUntilDone();
+};
+// ------------------------------------------------------------------
+#endif
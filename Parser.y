@@ -19,6 +19,8 @@
 	struct NameList *attsToSelect; // the set of attributes in the SELECT (NULL if no such atts)
 	int distinctAtts; // 1 if there is a DISTINCT in a non-aggregate query 
 	int distinctFunc;  // 1 if there is a DISTINCT in an aggregate query
+	struct NameList *orderingAtts; // ordering atts (NULL if no ORDER BY)
+	int limitCount; // number of rows to return (0 if there is no LIMIT)
 
 %}
 
@@ -50,6 +52,8 @@
 %token AS
 %token AND
 %token OR
+%token ORDER
+%token LIMIT
 
 %type <myOrList> OrList
 %type <myAndList> AndList
@@ -61,6 +65,7 @@
 %type <myTables> Tables
 %type <myBoolOperand> Literal
 %type <myNames> Atts
+%type <myNames> OrderAtts
 
 %start SQL
 
@@ -74,20 +79,53 @@
 
 %%
 
-SQL: SELECT WhatIWant FROM Tables WHERE AndList
+SQL: SELECT WhatIWant FROM Tables WHERE AndList OrderBy
 {
 	tables = $4;
 	boolean = $6;	
 	groupingAtts = NULL;
 }
 
-| SELECT WhatIWant FROM Tables WHERE AndList GROUP BY Atts
+| SELECT WhatIWant FROM Tables WHERE AndList GROUP BY Atts OrderBy
 {
 	tables = $4;
 	boolean = $6;	
 	groupingAtts = $9;
 };
 
+OrderBy: /* no ordering */
+{
+	orderingAtts = NULL;
+	limitCount = 0;
+}
+
+| ORDER BY OrderAtts
+{
+	orderingAtts = $3;
+	limitCount = 0;
+}
+
+| ORDER BY OrderAtts LIMIT Int
+{
+	orderingAtts = $3;
+	limitCount = atoi ($5);
+};
+
+OrderAtts: Name
+{
+	$$ = (struct NameList *) malloc (sizeof (struct NameList));
+	$$->name = $1;
+	$$->next = NULL;
+}
+
+| Name ',' OrderAtts
+{
+	// unlike Atts the list keeps the order the attributes were written in
+	$$ = (struct NameList *) malloc (sizeof (struct NameList));
+	$$->name = $1;
+	$$->next = $3;
+};
+
 WhatIWant: Function ',' Atts 
 {
 	attsToSelect = $3;
@@ -66,6 +66,36 @@ void Pipe :: Insert (Record *insertMe) {
 }
 
 
+void Pipe :: Insert (Record *insertMe, int numRecords) {
+
+	// first, get a mutex on the pipeline
+	pthread_mutex_lock (&pipeMutex);
+
+	int inserted = 0;
+	while (inserted < numRecords) {
+
+		// wait until the consumer frees up some space in the pipeline
+		while (lastSlot - firstSlot >= totSpace) {
+			pthread_cond_wait (&producerVar, &pipeMutex);
+		}
+
+		// fill every free slot before waking the consumer
+		while (inserted < numRecords && lastSlot - firstSlot < totSpace) {
+			buffered [lastSlot % totSpace].Consume (&insertMe[inserted]);
+			lastSlot++;
+			inserted++;
+		}
+
+		// signal the consumer who might now want to suck up the new
+		// records that have been added to the pipeline
+		pthread_cond_signal (&consumerVar);
+	}
+
+	// done!
+	pthread_mutex_unlock (&pipeMutex);
+}
+
+
 int Pipe :: Remove (Record *removeMe) {
 	 
 	// first, get a mutex on the pipeline
@@ -115,6 +145,36 @@ int Pipe :: Remove (Record *removeMe) {
 }
 
 
+int Pipe :: Remove (Record *removeMe, int maxRecords) {
+
+	// first, get a mutex on the pipeline
+	pthread_mutex_lock (&pipeMutex);
+
+	// wait until there is something there, unless the pipe was turned off
+	while (lastSlot == firstSlot && !done) {
+		pthread_cond_wait (&consumerVar, &pipeMutex);
+	}
+
+	// take everything the producer has put in so far
+	int removed = 0;
+	while (removed < maxRecords && lastSlot != firstSlot) {
+		removeMe[removed].Consume (&buffered [firstSlot % totSpace]);
+		firstSlot++;
+		removed++;
+	}
+
+	// signal the producer who might now want to take the slots
+	// that have been freed up by the deletion
+	if (removed > 0) {
+		pthread_cond_signal (&producerVar);
+	}
+
+	// done!
+	pthread_mutex_unlock (&pipeMutex);
+	return removed;
+}
+
+
 void Pipe :: ShutDown () {
 
 	// first, get a mutex on the pipeline
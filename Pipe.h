@@ -38,6 +38,12 @@ public:
 	// no longer be used and will be zero'ed out
 	void Insert (Record *insertMe);
 
+	// This inserts numRecords records from the array at once, taking
+	// the mutex and waking the consumer once for every run of free
+	// slots rather than once per record; it may block like Insert.
+	// All of the records are consumed
+	void Insert (Record *insertMe, int numRecords);
+
 	// This removes a record from the pipeline and puts it into the
 	// argument.  Note that whatever was in the parameter before the
 	// call will be lost.  This may block if there are no records in
@@ -45,6 +51,12 @@ public:
 	// and a zero if there are no more records in the pipeline
 	int Remove (Record *removeMe);
 
+	// This removes up to maxRecords records into the array, waiting
+	// only if the pipeline is empty, and wakes the producer once for
+	// all of them.  The return value is the number of records removed,
+	// zero if there are no more records in the pipeline
+	int Remove (Record *removeMe, int maxRecords);
+
 	// shut down the pipepine; used by the consumer to signal that 
 	// there is no more data that is going to be added into the pipe
 	void ShutDown ();
@@ -8,6 +8,9 @@
 #include "ParseTree.h"
 #include "Statistics.h"
 #include "Comparison.h"
+#include "MemoryGovernor.h"
+#include "Utilities.h"
+#include <algorithm>
 
 char *supplier = "supplier";
 char *partsupp = "partsupp";
@@ -27,6 +30,12 @@ const int npartsupp = 800000;
 const int nregion = 5;
 const int nsupplier = 10000;
 
+// directory holding the table files, <table>.bin
+char *dbfileDir = "dbfiles/";
+
+// bytes of memory shared by all the operators of a query
+const long long queryMemoryBudget = 100 * (long long) PAGE_SIZE;
+
 static int pidBuffer = 0;
 int getPid () {
 	return ++pidBuffer;
@@ -138,6 +147,146 @@ void initStatistics (Statistics &s) {
 	
 }
 
+// opens an account with the memory governor for a node that buffers
+// records, weighted by the number of tuples flowing into it
+void RegisterMemory (QueryNode *node, double inputTuples, MemoryGovernor &governor, vector<QueryNode *> &consumers) {
+	
+	node->memoryId = governor.Register (inputTuples);
+	consumers.push_back (node);
+	
+}
+
+// bytes a string attribute is assumed to take when sizing records
+const int estimatedStringBytes = 32;
+
+// estimated bytes of a record of the schema
+double EstimateRecordBytes (Schema &sch) {
+	
+	double bytes = sizeof (int) * (sch.GetNumAtts () + 1);
+	Attribute *atts = sch.GetAtts ();
+	for (int i = 0; i < sch.GetNumAtts (); i++) {
+		
+		bytes += atts[i].myType == Int ? sizeof (int) : atts[i].myType == Double ? sizeof (double) : estimatedStringBytes;
+		
+	}
+	return bytes;
+	
+}
+
+// true if an index of the file (the sort order of a sorted file) starts
+// with one of the attributes of order, so that GetNext can seek to them
+bool HasProbeIndex (DBFile &file, OrderMaker &order) {
+	
+	for (int i = 0; i < file.GetNumIndexes (); i++) {
+		
+		OrderMaker key;
+		file.GetIndexKey (i, key);
+		if (key.numAtts > 0 && find (order.whichAtts, order.whichAtts + order.numAtts, key.whichAtts[0]) != order.whichAtts + order.numAtts) {
+			
+			return true;
+			
+		}
+		
+	}
+	return false;
+	
+}
+
+// smallest share of the records of a probe scan a join filter is expected
+// to drop for the join to build one
+const double joinFilterMinDrop = 0.1;
+
+// a hash join, or a sort-merge join that sorts its left input, builds a
+// filter on its build keys (the left ones of a sort-merge join) for a probe
+// input read by a SelectFile, when the filter is estimated to drop enough
+// of its records: every probe record with a match gives at least one
+// output record, and the others get through at the false positive rate
+void PlanJoinFilter (JoinNode *node) {
+	
+	if (node->method == SortMerge && node->sortedLeft) {
+		
+		return;
+		
+	}
+	QueryNode *probe = node->method != SortMerge && !node->buildLeft ? node->left : node->right;
+	if (probe->t != SF) {
+		
+		return;
+		
+	}
+	double matched = min (probe->estimate, node->estimate);
+	double drops = (probe->estimate - matched) * (1 - JOIN_FILTER_FALSE_RATE);
+	if (drops < joinFilterMinDrop * probe->estimate) {
+		
+		return;
+		
+	}
+	node->filterProbe = 1;
+	((SelectFileNode *) probe)->filterPid = node->pid;
+	((SelectFileNode *) probe)->filterDrops = drops;
+	
+}
+
+// an equi-join whose right table has an index on the join attributes probes
+// it for every left record when there are fewer left records than pages in
+// the table, as a probe reads about one page and a scan reads them all.
+// Otherwise an equi-join whose smaller input is estimated to fit in the
+// query memory budget is run as a hash join building on that input, radix
+// partitioned when its table would not fit in the cache; the others, whose
+// hash tables would spill anyway, are run as sort-merge joins. A join
+// without an equality can only be run as a block nested-loop join.
+// Before all of these, a join whose inputs both arrive sorted on the join
+// attributes is merged without sorting, and keeps the order. Hash and
+// sort-merge joins are then given a join filter where it pays.
+void PlanJoin (JoinNode *node) {
+	
+	OrderMaker left, right;
+	if (!node->cnf.GetSortOrders (left, right)) {
+		
+		node->method = BlockNestedLoop;
+		return;
+		
+	}
+	
+	Join::AlignInputOrders (node->left->outputOrder, node->right->outputOrder, left, right, node->sortedLeft, node->sortedRight);
+	if (node->sortedLeft && node->sortedRight) {
+		
+		node->method = SortMerge;
+		node->outputOrder = left;
+		return;
+		
+	}
+	
+	if (node->right->t == SF) {
+		
+		// an index-only scan does not have the records the join needs
+		SelectFileNode *inner = (SelectFileNode *) node->right;
+		double scanPages = inner->estimate * EstimateRecordBytes (inner->sch) / PAGE_SIZE;
+		if (inner->opened && inner->coveringIndex < 0 && HasProbeIndex (inner->file, right) && node->left->estimate < scanPages) {
+			
+			node->method = IndexNestedLoop;
+			return;
+			
+		}
+		
+	}
+	
+	node->buildLeft = node->left->estimate < node->right->estimate;
+	QueryNode *build = node->buildLeft ? node->left : node->right;
+	if (build->estimate * EstimateRecordBytes (build->sch) <= queryMemoryBudget) {
+		
+		node->method = build->estimate > RADIX_PARTITION_ENTRIES ? RadixHash : HybridHash;
+		
+	} else {
+		
+		// the merge gives the records in the order of the left join attributes
+		node->outputOrder = left;
+		
+	}
+	PlanJoinFilter (node);
+	
+}
+
 void PrintParseTree (struct AndList *andPointer) {
   
 	cout << "(";
@@ -258,6 +407,116 @@ void CopyNameList(NameList *nameList, vector<string> &names) {
 	
 }
 
+void CopyCNFNames (AndList *andList, vector<string> &names) {
+	
+	for (; andList; andList = andList->rightAnd) {
+		
+		for (OrList *orList = andList->left; orList; orList = orList->rightOr) {
+			
+			if (orList->left->left->code == NAME) {
+				
+				names.push_back (string (orList->left->left->value));
+				
+			}
+			if (orList->left->right->code == NAME) {
+				
+				names.push_back (string (orList->left->right->value));
+				
+			}
+			
+		}
+		
+	}
+	
+}
+
+void CopyFunctionNames (FuncOperator *func, vector<string> &names) {
+	
+	if (func) {
+		
+		if (func->leftOperand && func->leftOperand->code == NAME) {
+			
+			names.push_back (string (func->leftOperand->value));
+			
+		}
+		CopyFunctionNames (func->leftOperator, names);
+		CopyFunctionNames (func->right, names);
+		
+	}
+	
+}
+
+// opens the table of a select file node and, when one index of the table
+// holds every attribute of it the query reads, plans an index-only scan:
+// the node then outputs the key attributes and never reads the records.
+// Must run before the node's CNF is grown, as it narrows the schema.
+void PlanSelectFile (SelectFileNode *node, string tableName, vector<string> &queryAtts) {
+	
+	string path = string (dbfileDir) + tableName + ".bin";
+	node->opened = Utilities::checkfileExist (path) && node->file.Open (path.c_str ());
+	if (!node->opened) {
+		
+		return;
+		
+	}
+	
+	vector<int> needed;
+	for (int i = 0; i < queryAtts.size (); i++) {
+		
+		int att = node->sch.Find ((char *) queryAtts[i].c_str ());
+		if (att != -1) {
+			
+			needed.push_back (att);
+			
+		}
+		
+	}
+	
+	// the narrowest covering index reads the fewest bytes
+	OrderMaker best;
+	for (int i = 0; i < node->file.GetNumIndexes (); i++) {
+		
+		OrderMaker key;
+		node->file.GetIndexKey (i, key);
+		bool covers = true;
+		for (int j = 0; j < needed.size () && covers; j++) {
+			
+			covers = find (key.whichAtts, key.whichAtts + key.numAtts, needed[j]) != key.whichAtts + key.numAtts;
+			
+		}
+		if (covers && (node->coveringIndex < 0 || key.numAtts < best.numAtts)) {
+			
+			node->coveringIndex = i;
+			best = key;
+			
+		}
+		
+	}
+	
+	if (node->coveringIndex >= 0) {
+		
+		Attribute *atts = node->sch.GetAtts ();
+		vector<Attribute> keyAtts;
+		for (int i = 0; i < best.numAtts; i++) {
+			
+			keyAtts.push_back (atts[best.whichAtts[i]]);
+			
+			// the index gives its narrow records in key order
+			node->outputOrder.whichAtts[i] = i;
+			node->outputOrder.whichTypes[i] = best.whichTypes[i];
+			
+		}
+		node->outputOrder.numAtts = best.numAtts;
+		node->sch = Schema ((char *) tableName.c_str (), keyAtts.size (), &keyAtts[0]);
+		
+	} else {
+		
+		node->file.GetSortOrder (node->outputOrder);
+		
+	}
+	
+}
+
 void PrintFunction (FuncOperator *func) {
 	
 	if (func) {
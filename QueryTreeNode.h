@@ -4,11 +4,12 @@
 #include "Schema.h"
 #include "DBFile.h"
 #include "Function.h"
+#include "RelOp.h"
 #include <iostream>
 
 
 enum NodeType {
-	G, SF, SP, P, D, S, GB, J, W
+	G, SF, SP, P, D, S, GB, J, W, O
 };
 
 class QueryNode {
@@ -20,12 +21,27 @@ public:
 	NodeType t;
 	Schema sch;  // Ouput Schema
 	
+	double estimate;  // estimated number of output tuples
+	OrderMaker outputOrder;  // order of the output records, no attributes if none
+	int memoryId;  // account with the memory governor, -1 if none
+	long long memoryShare;  // bytes of the query memory budget planned for the node
+	
 	QueryNode ();
-	QueryNode (NodeType type) : t (type) {}
+	QueryNode (NodeType type) : t (type), estimate (0), memoryId (-1), memoryShare (0) {}
 	
 	~QueryNode () {}
 	virtual void Print () {};
 	
+	void PrintMemory () {
+		
+		if (memoryId >= 0) {
+			
+			cout << "Memory Share : " << memoryShare << " bytes" << endl;
+			
+		}
+		
+	}
+	
 };
 
 class JoinNode : public QueryNode {
@@ -36,8 +52,13 @@ public:
 	QueryNode *right;
 	CNF cnf;
 	Record literal;
+	JoinMethod method;
+	int buildLeft;  // a hash join builds on the left input, else on the right
+	int sortedLeft;  // a sort-merge join merges the left input without sorting it
+	int sortedRight;
+	int filterProbe;  // the join builds a filter for the scan of its probe input
 	
-	JoinNode () : QueryNode (J) {}
+	JoinNode () : QueryNode (J), method (SortMerge), buildLeft (0), sortedLeft (0), sortedRight (0), filterProbe (0) {}
 	~JoinNode () {
 		
 		if (left) delete left;
@@ -56,6 +77,38 @@ public:
 		sch.Print ();
 		cout << "Join CNF : " << endl;
 		cnf.Print ();
+		if (method == HybridHash || method == RadixHash) {
+			
+			cout << "Join Method : " << (method == RadixHash ? "Radix Hash" : "Hybrid Hash");
+			cout << ", build on " << (buildLeft ? "left" : "right") << endl;
+			
+		} else if (method == IndexNestedLoop) {
+			
+			cout << "Join Method : Index Nested Loop, probing the right file" << endl;
+			
+		} else if (method == BlockNestedLoop) {
+			
+			cout << "Join Method : Block Nested Loop" << endl;
+			
+		} else {
+			
+			cout << "Join Method : Sort Merge" << endl;
+			if (sortedLeft || sortedRight) {
+				
+				// the input already arrives in the join order
+				cout << "Inputs Not Sorted :" << (sortedLeft ? " left" : "") << (sortedRight ? " right" : "") << endl;
+				
+			}
+			
+		}
+		if (filterProbe) {
+			
+			// a sort-merge join builds the filter on its left input
+			QueryNode *probe = method != SortMerge && !buildLeft ? left : right;
+			cout << "Join Filter : on the build keys, for Pipe ID " << probe->pid << endl;
+			
+		}
+		PrintMemory ();
 		cout << "*********************" << endl;
 		
 		left->Print ();
@@ -109,12 +162,15 @@ class SelectFileNode : public QueryNode {
 public:
 	
 	bool opened;
+	int coveringIndex;  // index of the file answering the scan alone, -1 if the records are read
+	int filterPid;  // output pipe of the join whose filter the scan applies, -1 if none
+	double filterDrops;  // estimated number of records the filter drops
 	
 	CNF cnf;
 	DBFile file;
 	Record literal;
 	
-	SelectFileNode () : QueryNode (SF) {}
+	SelectFileNode () : QueryNode (SF), opened (false), coveringIndex (-1), filterPid (-1), filterDrops (0) {}
 	~SelectFileNode () {
 		
 		if (opened) {
@@ -129,11 +185,23 @@ public:
 		
 		cout << "*********************" << endl;
 		cout << "Select File Operation" << endl;
+		if (coveringIndex >= 0) {
+			
+			// every attribute the query reads from the table is in the index
+			cout << "Index Only Scan : index " << coveringIndex << endl;
+			
+		}
 		cout << "Output Pipe ID " << pid << endl;
 		cout << "Output Schema:" << endl;
 		sch.Print ();
 		cout << "Select CNF:" << endl;
 		cnf.Print ();
+		if (filterPid >= 0) {
+			
+			cout << "Join Filter : from Join with Output Pipe ID " << filterPid;
+			cout << ", estimated to drop " << (long long) filterDrops << " records" << endl;
+			
+		}
 		cout << "*********************" << endl;
 		
 	}
@@ -222,6 +290,7 @@ public:
 		cout << "Duplication Elimation Operation" << endl;
 		cout << "Input Pipe ID : " << from->pid << endl;
 		cout << "Output Pipe ID : " << pid << endl;
+		PrintMemory ();
 		cout << "*********************" << endl;
 		
 		from->Print ();
@@ -258,6 +327,48 @@ public:
 		compute.Print ();
 		cout << "OrderMaker : " << endl;
 		group.Print ();
+		PrintMemory ();
+		cout << "*********************" << endl;
+		
+		from->Print ();
+		
+	}
+	
+};
+
+class OrderByNode : public QueryNode {
+
+public:
+	
+	QueryNode *from;
+	
+	OrderMaker order;
+	int limit;  // 0 if every record is kept
+	
+	OrderByNode () : QueryNode (O), limit (0) {}
+	~OrderByNode () {
+		
+		if (from) delete from;
+		
+	}
+	
+	void Print () {
+		
+		cout << "*********************" << endl;
+		cout << "Order By Operation" << endl;
+		cout << "Input Pipe ID : " << from->pid << endl;
+		cout << "Output Pipe ID : " << pid << endl;
+		cout << "Output Schema : " << endl;
+		sch.Print ();
+		cout << "OrderMaker : " << endl;
+		order.Print ();
+		if (limit > 0) {
+			
+			// the sort keeps only limit records in memory and never spills
+			cout << "Limit : " << limit << " (Top-K sort)" << endl;
+			
+		}
+		PrintMemory ();
 		cout << "*********************" << endl;
 		
 		from->Print ();
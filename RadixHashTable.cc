@@ -0,0 +1,162 @@
+#include "RadixHashTable.h"
+
+// scatters n entries from in to out on width hash bits from shift; starts
+// gets the first entry of each of the 2^width partitions and the end
+static void ScatterPass(RadixEntry * in, RadixEntry * out, int n, int shift, int width, int * starts){
+    int numPartitions = 1 << width;
+    unsigned long mask = numPartitions - 1;
+    vector<int> position(numPartitions, 0);
+    for(int i = 0; i < n; i++){
+        position[(in[i].hash >> shift) & mask]++;
+    }
+    int sum = 0;
+    for(int p = 0; p < numPartitions; p++){
+        starts[p] = sum;
+        sum += position[p];
+        position[p] = starts[p];
+    }
+    starts[numPartitions] = sum;
+    for(int i = 0; i < n; i++){
+        out[position[(in[i].hash >> shift) & mask]++] = in[i];
+    }
+}
+
+// ------------------------------------------------------------------
+RadixHashTable :: RadixHashTable(){
+    bits = 0;
+    numBytes = 0;
+}
+
+RadixHashTable :: ~RadixHashTable(){
+    for(int i = 0; i < entries.size(); i++){
+        delete entries[i].rec;
+    }
+}
+
+void RadixHashTable :: Add(unsigned long hash, Record * rec){
+    RadixEntry entry = {hash, rec};
+    entries.push_back(entry);
+    numBytes += ((int *) rec->bits)[0] + sizeof(Record) + sizeof(RadixEntry);
+}
+
+long long RadixHashTable :: GetNumEntries(){
+    return entries.size();
+}
+
+long long RadixHashTable :: GetNumBytes(){
+    return numBytes;
+}
+
+Record * RadixHashTable :: GetRecord(int entry){
+    return entries[entry].rec;
+}
+
+unsigned long RadixHashTable :: GetHash(int entry){
+    return entries[entry].hash;
+}
+
+int RadixHashTable :: GetBits(){
+    return bits;
+}
+
+void RadixHashTable :: Partition(vector<RadixEntry> &entries, int bits, vector<int> &starts){
+    int n = entries.size();
+    starts.assign((1 << bits) + 1, 0);
+    if(bits == 0){
+        starts[1] = n;
+        return;
+    }
+    vector<RadixEntry> scratch(n);
+    if(bits <= RADIX_PASS_BITS){
+        ScatterPass(&entries[0], &scratch[0], n, 0, bits, &starts[0]);
+        entries.swap(scratch);
+        return;
+    }
+    // the first pass splits on the high bits, the second splits every one
+    // of its partitions on the low bits, back into entries
+    int highBits = (bits + 1) / 2;
+    int lowBits = bits - highBits;
+    vector<int> highStarts((1 << highBits) + 1);
+    ScatterPass(&entries[0], &scratch[0], n, lowBits, highBits, &highStarts[0]);
+    for(int p = 0; p < (1 << highBits); p++){
+        int first = highStarts[p];
+        int * partStarts = &starts[p << lowBits];
+        ScatterPass(&scratch[first], &entries[first], highStarts[p + 1] - first, 0, lowBits, partStarts);
+        for(int i = 0; i <= (1 << lowBits); i++){
+            partStarts[i] += first;
+        }
+    }
+}
+
+void RadixHashTable :: Build(int numThreads){
+    int n = entries.size();
+    bits = 0;
+    while((n >> bits) > RADIX_PARTITION_ENTRIES && bits < 2 * RADIX_PASS_BITS){
+        bits++;
+    }
+    Partition(entries, bits, partitionStart);
+
+    int numPartitions = 1 << bits;
+    bucketStart.assign(numPartitions + 1, 0);
+    for(int p = 0; p < numPartitions; p++){
+        int numBuckets = 1;
+        while(numBuckets < partitionStart[p + 1] - partitionStart[p]){
+            numBuckets <<= 1;
+        }
+        bucketStart[p + 1] = bucketStart[p] + numBuckets;
+    }
+    buckets.assign(bucketStart[numPartitions], -1);
+    next.resize(n);
+
+    nextPartition = 0;
+    if(numThreads > numPartitions){
+        numThreads = numPartitions;
+    }
+    vector<pthread_t> workers(numThreads);
+    for(int i = 0; i < numThreads; i++){
+        pthread_create(&workers[i], NULL, RadixHashTable::BuildWorker, this);
+    }
+    for(int i = 0; i < numThreads; i++){
+        pthread_join(workers[i], NULL);
+    }
+}
+
+void * RadixHashTable :: BuildWorker(void * arg){
+    ((RadixHashTable *) arg)->BuildTables();
+    return NULL;
+}
+
+void RadixHashTable :: BuildTables(){
+    int numPartitions = 1 << bits;
+    while(true){
+        int p = nextPartition++;
+        if(p >= numPartitions){
+            break;
+        }
+        unsigned long mask = bucketStart[p + 1] - bucketStart[p] - 1;
+        for(int i = partitionStart[p]; i < partitionStart[p + 1]; i++){
+            int bucket = bucketStart[p] + ((entries[i].hash >> bits) & mask);
+            next[i] = buckets[bucket];
+            buckets[bucket] = i;
+        }
+    }
+}
+
+int RadixHashTable :: GetFirst(unsigned long hash){
+    int p = hash & ((1UL << bits) - 1);
+    unsigned long mask = bucketStart[p + 1] - bucketStart[p] - 1;
+    int entry = buckets[bucketStart[p] + ((hash >> bits) & mask)];
+    while(entry >= 0 && entries[entry].hash != hash){
+        entry = next[entry];
+    }
+    return entry;
+}
+
+int RadixHashTable :: GetNext(int entry, unsigned long hash){
+    entry = next[entry];
+    while(entry >= 0 && entries[entry].hash != hash){
+        entry = next[entry];
+    }
+    return entry;
+}
+// ------------------------------------------------------------------
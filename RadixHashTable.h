@@ -0,0 +1,73 @@
+#ifndef RADIX_HASH_TABLE_H
+#define RADIX_HASH_TABLE_H
+
+#include <pthread.h>
+#include <atomic>
+#include <vector>
+#include "Record.h"
+using namespace std;
+
+// entries a partition is sized for: an entry, its chain link and its
+// bucket take up to 32 bytes, so a partition fits in a 256 KB L2 cache
+#define RADIX_PARTITION_ENTRIES 8192
+// hash bits one partitioning pass splits on; scattering into more
+// partitions at once would miss in the TLB
+#define RADIX_PASS_BITS 7
+
+// ------------------------------------------------------------------
+// structure to encapsulate a record and the hash of its key
+typedef struct {
+    unsigned long hash;
+    Record * rec;
+} RadixEntry;
+// ------------------------------------------------------------------
+
+// ------------------------------------------------------------------
+// Class used to hold the build side of a radix hash join in memory. Build
+// cuts the entries into 2^bits partitions on the low bits of their hashes,
+// in one or two passes of at most RADIX_PASS_BITS bits, so that every
+// partition holds about RADIX_PARTITION_ENTRIES entries, then gives every
+// partition a bucket array of its own (chained through the entries, on
+// the hash bits above the partition bits). A probe that is partitioned the
+// same way then only touches one cache sized table at a time.
+class RadixHashTable {
+    // partition after partition once built
+    vector<RadixEntry> entries;
+    // first entry of every partition, and the end of the last
+    vector<int> partitionStart;
+    // first bucket of every partition, and the end of the last
+    vector<int> bucketStart;
+    // first entry of the chain of every bucket, -1 if empty
+    vector<int> buckets;
+    // next entry of the chain of every entry
+    vector<int> next;
+    int bits;
+    long long numBytes;
+    // partition whose table is built next, shared by the build threads
+    atomic<int> nextPartition;
+    static void * BuildWorker(void * arg);
+    //      function to build the tables of partitions until there are none left
+    void BuildTables();
+public:
+    RadixHashTable();
+    //      deletes the records
+    ~RadixHashTable();
+    //      function to add a record with the hash of its key, the record is owned by the table
+    void Add(unsigned long hash, Record * rec);
+    long long GetNumEntries();
+    //      bytes of the records added, as counted against the join's memory
+    long long GetNumBytes();
+    Record * GetRecord(int entry);
+    unsigned long GetHash(int entry);
+    //      function to partition the entries and build the tables on numThreads threads
+    void Build(int numThreads);
+    int GetBits();
+    //      first entry with the hash, then the next one after entry; -1 at the end
+    int GetFirst(unsigned long hash);
+    int GetNext(int entry, unsigned long hash);
+    //      function to reorder entries partition after partition on the low bits of
+    //      their hashes; starts gets the first entry of every partition and the end
+    static void Partition(vector<RadixEntry> &entries, int bits, vector<int> &starts);
+};
+// ------------------------------------------------------------------
+#endif
@@ -1,12 +1,995 @@
 #include "RelOp.h"
+#include "Utilities.h"
+#include <unordered_map>
+#include <unistd.h>
+#include <algorithm>
+
+// spreads every bit of a key hash over the whole word
+static unsigned long MixHash (unsigned long hash) {
+
+	hash ^= hash >> 33;
+	hash *= 0xff51afd7ed558ccdUL;
+	hash ^= hash >> 33;
+	hash *= 0xc4ceb9fe1a85ec53UL;
+	hash ^= hash >> 33;
+	return hash;
+}
+
+JoinFilter::JoinFilter () {
+
+	published = 0;
+	disabled = 0;
+	probed = 0;
+	dropped = 0;
+	pthread_mutex_init (&lock, NULL);
+	pthread_cond_init (&ready, NULL);
+}
+
+JoinFilter::~JoinFilter () {
+
+	pthread_mutex_destroy (&lock);
+	pthread_cond_destroy (&ready);
+}
+
+void JoinFilter::Add (unsigned long hash) {
+	keys.push_back (hash);
+}
+
+void JoinFilter::Publish (OrderMaker &probeOrder) {
+
+	pthread_mutex_lock (&lock);
+	if (!published) {
+
+		long long numBlocks = (keys.size () * JOIN_FILTER_BITS_PER_KEY + 511) / 512;
+		blocks.assign ((numBlocks > 0 ? numBlocks : 1) * 8, 0);
+		for (int i = 0; i < keys.size (); i++) {
+
+			// the block from one mix of the hash, the bits in it from another
+			unsigned long hash = MixHash (keys[i]);
+			unsigned long *block = &blocks[(hash % (blocks.size () / 8)) * 8];
+			unsigned long bits = MixHash (hash);
+			for (int j = 0; j < JOIN_FILTER_HASHES; j++, bits >>= 9) {
+				block[(bits & 511) >> 6] |= 1UL << (bits & 63);
+			}
+		}
+		vector<unsigned long> ().swap (keys);
+		this->probeOrder = probeOrder;
+		published = 1;
+	}
+	pthread_cond_broadcast (&ready);
+	pthread_mutex_unlock (&lock);
+}
+
+void JoinFilter::Disable () {
+
+	pthread_mutex_lock (&lock);
+	if (!published) {
+		vector<unsigned long> ().swap (keys);
+		disabled = 1;
+		published = 1;
+	}
+	pthread_cond_broadcast (&ready);
+	pthread_mutex_unlock (&lock);
+}
+
+void JoinFilter::WaitUntilReady () {
+
+	pthread_mutex_lock (&lock);
+	while (!published) {
+		pthread_cond_wait (&ready, &lock);
+	}
+	pthread_mutex_unlock (&lock);
+}
+
+int JoinFilter::Pass (Record *rec) {
+
+	if (disabled) {
+		return 1;
+	}
+	probed++;
+	unsigned long hash = MixHash (probeOrder.Hash (rec));
+	unsigned long *block = &blocks[(hash % (blocks.size () / 8)) * 8];
+	unsigned long bits = MixHash (hash);
+	for (int j = 0; j < JOIN_FILTER_HASHES; j++, bits >>= 9) {
+		if (!(block[(bits & 511) >> 6] & (1UL << (bits & 63)))) {
+			dropped++;
+			return 0;
+		}
+	}
+	return 1;
+}
+
+long long JoinFilter::GetProbed () {
+	return probed;
+}
+
+long long JoinFilter::GetDropped () {
+	return dropped;
+}
 
 void SelectFile::Run (DBFile &inFile, Pipe &outPipe, CNF &selOp, Record &literal) {
+
+	this->inFile = &inFile;
+	this->outPipe = &outPipe;
+	this->selOp = &selOp;
+	this->literal = &literal;
+	pthread_create (&thread, NULL, SelectFile::Work, this);
+}
+
+void *SelectFile::Work (void *arg) {
+
+	SelectFile *op = (SelectFile *) arg;
+	Record *batch = new Record[OUTPUT_BATCH];
+	off_t numPages;
+	File *pageFile = op->inFile->GetPageFile (numPages);
+
+	// the join only knows which records to let through once it has read its build input
+	if (op->filter != NULL) {
+		op->filter->WaitUntilReady ();
+	}
+
+	if (pageFile != NULL && op->inFile->GetNumIndexes () == 0) {
+
+		op->ScanPages (pageFile, numPages, batch);
+
+	} else {
+
+		// the file finds the matching records itself, by binary search or index probe
+		int batchSize = 0;
+		op->inFile->MoveFirst ();
+		while (op->inFile->GetNext (batch[batchSize], *op->selOp, *op->literal)) {
+
+			if (op->filter != NULL && !op->filter->Pass (&batch[batchSize])) {
+				continue;
+			}
+			if (++batchSize == OUTPUT_BATCH) {
+				op->outPipe->Insert (batch, batchSize);
+				batchSize = 0;
+			}
+		}
+		if (batchSize > 0) {
+			op->outPipe->Insert (batch, batchSize);
+		}
+	}
+
+	delete [] batch;
+	op->outPipe->ShutDown ();
+	return NULL;
+}
+
+void SelectFile::ScanPages (File *pageFile, off_t numPages, Record *batch) {
+
+	Page page;
+	Record rec;
+	ComparisonEngine comp;
+	int batchSize = 0;
+
+	// keep one window of readAhead pages requested beyond the page being read
+	pageFile->ReadAhead (0, readAhead);
+	off_t requested = readAhead;
+	for (off_t whichPage = 0; whichPage < numPages; whichPage++) {
+
+		if (whichPage + readAhead > requested) {
+			pageFile->ReadAhead (requested, readAhead);
+			requested += readAhead;
+		}
+		pageFile->GetPage (&page, whichPage);
+		while (page.GetFirst (&rec)) {
+
+			if (!comp.Compare (&rec, literal, selOp)) {
+				continue;
+			}
+			if (filter != NULL && !filter->Pass (&rec)) {
+				continue;
+			}
+			batch[batchSize++].Consume (&rec);
+			if (batchSize == OUTPUT_BATCH) {
+				outPipe->Insert (batch, batchSize);
+				batchSize = 0;
+			}
+		}
+	}
+	if (batchSize > 0) {
+		outPipe->Insert (batch, batchSize);
+	}
 }
 
 void SelectFile::WaitUntilDone () {
-	// pthread_join (thread, NULL);
+	pthread_join (thread, NULL);
 }
 
 void SelectFile::Use_n_Pages (int runlen) {
+	readAhead = runlen > 0 ? runlen : 1;
+}
+
+void SelectFile::Use_Filter (JoinFilter &filter) {
+	this->filter = &filter;
+}
+
+RecordGroup::RecordGroup (int maxPages) {
+
+	this->maxPages = maxPages > 0 ? maxPages : 1;
+	pages.push_back (new Page ());
+	spillPath = NULL;
+	spilledPages = 0;
+}
+
+RecordGroup::~RecordGroup () {
+
+	for (int i = 0; i < pages.size (); i++) {
+		delete pages[i];
+	}
+	if (spillPath != NULL) {
+		spillFile.Close ();
+		remove (spillPath);
+		delete [] spillPath;
+	}
+}
+
+void RecordGroup::Add (Record *addMe) {
+
+	if (pages.back ()->Append (addMe)) {
+		return;
+	}
+	if (pages.size () < maxPages) {
+		pages.push_back (new Page ());
+	} else {
+		// memory is full, the last page becomes the buffer of the spill file
+		if (spillPath == NULL) {
+			spillPath = Utilities::newRandomFileName (".xbin");
+			spillFile.Open (0, spillPath);
+		}
+		spillFile.AddPage (pages.back (), spilledPages++);
+		pages.back ()->EmptyItOut ();
+	}
+	pages.back ()->Append (addMe);
+}
+
+void RecordGroup::Clear () {
+
+	for (int i = 1; i < pages.size (); i++) {
+		delete pages[i];
+	}
+	pages.resize (1);
+	pages[0]->EmptyItOut ();
+	// the spill file is kept and overwritten by the next group
+	spilledPages = 0;
+}
+
+int RecordGroup::IsEmpty () {
+	return pages.size () == 1 && pages[0]->getNumRecs () == 0;
+}
+
+void RecordGroup::MoveFirst () {
+
+	currentPage = -1;
+	currentRecords.clear ();
+	currentRecord = 0;
+}
+
+Record *RecordGroup::GetNext () {
+
+	while (currentRecord == currentRecords.size ()) {
+
+		if (++currentPage == pages.size () + spilledPages) {
+			currentPage--;
+			return NULL;
+		}
+		if (currentPage < pages.size ()) {
+			pages[currentPage]->GetRecords (currentRecords);
+		} else {
+			spillFile.GetPage (&spillPage, currentPage - pages.size ());
+			spillPage.GetRecords (currentRecords);
+		}
+		currentRecord = 0;
+	}
+	return currentRecords[currentRecord++];
+}
+
+void Join::Run (Pipe &inPipeL, Pipe &inPipeR, Pipe &outPipe, CNF &selOp, Record &literal) {
+
+	this->inPipeL = &inPipeL;
+	this->inPipeR = &inPipeR;
+	this->outPipe = &outPipe;
+	this->selOp = &selOp;
+	this->literal = &literal;
+	pthread_create (&thread, NULL, Join::Work, this);
+}
+
+void Join::Run (Pipe &inPipeL, DBFile &inFileR, CNF &selFileR, Record &literalR,
+	Pipe &outPipe, CNF &selOp, Record &literal) {
+
+	this->inPipeL = &inPipeL;
+	this->inPipeR = NULL;
+	this->inFileR = &inFileR;
+	this->selFileR = &selFileR;
+	this->literalR = &literalR;
+	this->outPipe = &outPipe;
+	this->selOp = &selOp;
+	this->literal = &literal;
+	pthread_create (&thread, NULL, Join::Work, this);
+}
+
+void *Join::Work (void *arg) {
+
+	Join *op = (Join *) arg;
+	OrderMaker orderL, orderR;
+
+	if (op->inFileR != NULL) {
+
+		if (!op->selOp->GetSortOrders (orderL, orderR)) {
+			cout << "ERROR: the join CNF has no equality to probe the file on!" << endl;
+			exit (1);
+		}
+		if (op->filter != NULL) {
+			op->filter->Disable ();
+		}
+		Record *batch = new Record[OUTPUT_BATCH];
+		int batchSize = 0;
+		op->IndexJoin (orderL, orderR, batch, batchSize);
+		if (batchSize > 0) {
+			op->outPipe->Insert (batch, batchSize);
+		}
+		delete [] batch;
+
+	} else if (op->method == BlockNestedLoop || !op->selOp->GetSortOrders (orderL, orderR)) {
+
+		if (op->filter != NULL) {
+			op->filter->Disable ();
+		}
+		Record *batch = new Record[OUTPUT_BATCH];
+		int batchSize = 0;
+		op->NestedLoopJoin (batch, batchSize);
+		if (batchSize > 0) {
+			op->outPipe->Insert (batch, batchSize);
+		}
+		delete [] batch;
+
+	} else if (op->method == HybridHash || op->method == RadixHash) {
+
+		op->buildOrder = op->buildLeft ? &orderL : &orderR;
+		op->probeOrder = op->buildLeft ? &orderR : &orderL;
+		op->memoryBytes = (long long) op->runLength * PAGE_SIZE;
+		if (op->governor != NULL) {
+			op->memoryBytes = op->governor->Acquire (op->memoryId, op->memoryBytes, PAGE_SIZE);
+		}
+
+		Record *batch = new Record[OUTPUT_BATCH];
+		int batchSize = 0;
+		Pipe *buildPipe = op->buildLeft ? op->inPipeL : op->inPipeR;
+		Pipe *probePipe = op->buildLeft ? op->inPipeR : op->inPipeL;
+		if (op->method == RadixHash) {
+			op->RadixJoin (buildPipe, probePipe, batch, batchSize);
+		} else {
+			op->HashJoin (buildPipe, NULL, probePipe, NULL, 0, batch, batchSize);
+		}
+		if (batchSize > 0) {
+			op->outPipe->Insert (batch, batchSize);
+		}
+		delete [] batch;
+
+		if (op->governor != NULL) {
+			op->governor->Release (op->memoryId, op->memoryBytes);
+		}
+
+	} else {
+
+		op->MergeJoin (orderL, orderR);
+	}
+
+	delete [] op->attsToKeep;
+	op->attsToKeep = NULL;
+	op->outPipe->ShutDown ();
+	return NULL;
+}
+
+void Join::MergeJoin (OrderMaker &orderL, OrderMaker &orderR) {
+
+	int inSortedL = 0, inSortedR = 0;
+	if (inputOrderL != NULL) {
+		AlignInputOrders (*inputOrderL, *inputOrderR, orderL, orderR, inSortedL, inSortedR);
+	}
+
+	// an input already in the join order is merged as it arrives
+	Pipe sortPipeL (JOIN_PIPE_SIZE), sortPipeR (JOIN_PIPE_SIZE);
+	Pipe &sortedL = inSortedL ? *inPipeL : sortPipeL;
+	Pipe &sortedR = inSortedR ? *inPipeR : sortPipeR;
+	// the left input of a filter goes through here to its sort
+	Pipe filteredL (JOIN_PIPE_SIZE);
+	int buildFilter = filter != NULL && !inSortedL;
+	SortOptions options;
+	options.governor = governor;
+	options.memoryId = memoryId;
+	// the sorts and the group of right records share the Use_n_Pages pages,
+	// or the share of the join when it has an account with the governor
+	int pages = runLength;
+	if (governor != NULL && governor->GetShare (memoryId) / PAGE_SIZE > pages) {
+		pages = governor->GetShare (memoryId) / PAGE_SIZE;
+	}
+	int sortLength = (pages - 1) / 2 > 0 ? (pages - 1) / 2 : 1;
+	int groupPages = pages - sortLength * (!inSortedL + !inSortedR);
+	if (groupPages < 1) {
+		groupPages = 1;
+	}
+	long long groupBytes = 0;
+	if (governor != NULL) {
+		// each sort plans with its part and the group holds the rest, taken
+		// before the sorts start so that they can not borrow it
+		options.memoryShare = (long long) sortLength * PAGE_SIZE;
+		groupBytes = governor->Acquire (memoryId, (long long) groupPages * PAGE_SIZE, PAGE_SIZE);
+		groupPages = groupBytes / PAGE_SIZE;
+	}
+	BigQ *sortL = inSortedL ? NULL : new BigQ (buildFilter ? filteredL : *inPipeL, sortPipeL, orderL, sortLength, options);
+	BigQ *sortR = inSortedR ? NULL : new BigQ (*inPipeR, sortPipeR, orderR, sortLength, options);
+
+	if (buildFilter) {
+
+		// every left key is known before the scan of the right input reads anything
+		Record *keys = new Record[OUTPUT_BATCH];
+		int numKeys;
+		while ((numKeys = inPipeL->Remove (keys, OUTPUT_BATCH)) > 0) {
+			for (int i = 0; i < numKeys; i++) {
+				filter->Add (orderL.Hash (keys + i));
+			}
+			filteredL.Insert (keys, numKeys);
+		}
+		delete [] keys;
+		filteredL.ShutDown ();
+		filter->Publish (orderR);
+
+	} else if (filter != NULL) {
+
+		// a sorted left input is merged as it arrives, too late for the filter
+		filter->Disable ();
+	}
+
+	ComparisonEngine comp;
+	RecordGroup group (groupPages);
+	Record *batch = new Record[OUTPUT_BATCH];
+	int batchSize = 0;
+	Record left, right, groupKey;
+	int hasLeft = sortedL.Remove (&left);
+	int hasRight = sortedR.Remove (&right);
+
+	while (hasLeft && hasRight) {
+
+		int result = comp.Compare (&left, &orderL, &right, &orderR);
+		if (result < 0) {
+			hasLeft = sortedL.Remove (&left);
+			continue;
+		}
+		if (result > 0) {
+			hasRight = sortedR.Remove (&right);
+			continue;
+		}
+
+		// collect every right record of the key, then match the left ones with it
+		group.Clear ();
+		groupKey.Copy (&right);
+		do {
+			group.Add (&right);
+			hasRight = sortedR.Remove (&right);
+		} while (hasRight && comp.Compare (&groupKey, &right, &orderR) == 0);
+
+		do {
+			group.MoveFirst ();
+			Record *match;
+			while ((match = group.GetNext ()) != NULL) {
+				if (comp.Compare (&left, match, literal, selOp)) {
+					Emit (&left, match, batch, batchSize);
+				}
+			}
+			hasLeft = sortedL.Remove (&left);
+		} while (hasLeft && comp.Compare (&left, &orderL, &groupKey, &orderR) == 0);
+	}
+
+	if (batchSize > 0) {
+		outPipe->Insert (batch, batchSize);
+	}
+	delete [] batch;
+
+	// the sorts (and producers) only finish once their output has been read
+	while (hasLeft) {
+		hasLeft = sortedL.Remove (&left);
+	}
+	while (hasRight) {
+		hasRight = sortedR.Remove (&right);
+	}
+	if (sortL != NULL) {
+		sortL->WaitUntilDone ();
+		delete sortL;
+	}
+	if (sortR != NULL) {
+		sortR->WaitUntilDone ();
+		delete sortR;
+	}
+	if (governor != NULL) {
+		governor->Release (memoryId, groupBytes);
+	}
+}
+
+// reorders the pairs of order and other so that order follows a prefix of
+// input; returns 0 if the attributes of order are not such a prefix
+static int AlignToInput (OrderMaker &input, OrderMaker &order, OrderMaker &other) {
+
+	if (input.numAtts < order.numAtts) {
+		return 0;
+	}
+	OrderMaker alignedOrder, alignedOther;
+	bool used[MAX_ANDS] = {false};
+	for (int i = 0; i < order.numAtts; i++) {
+
+		int pair = -1;
+		for (int j = 0; j < order.numAtts && pair < 0; j++) {
+			if (!used[j] && order.whichAtts[j] == input.whichAtts[i] && order.whichTypes[j] == input.whichTypes[i]) {
+				pair = j;
+			}
+		}
+		if (pair < 0) {
+			return 0;
+		}
+		used[pair] = true;
+		alignedOrder.whichAtts[i] = order.whichAtts[pair];
+		alignedOrder.whichTypes[i] = order.whichTypes[pair];
+		alignedOther.whichAtts[i] = other.whichAtts[pair];
+		alignedOther.whichTypes[i] = other.whichTypes[pair];
+	}
+	alignedOrder.numAtts = alignedOther.numAtts = order.numAtts;
+	order = alignedOrder;
+	other = alignedOther;
+	return 1;
+}
+
+// true if order is a prefix of input
+static int IsPrefixOf (OrderMaker &order, OrderMaker &input) {
+
+	if (input.numAtts < order.numAtts) {
+		return 0;
+	}
+	for (int i = 0; i < order.numAtts; i++) {
+		if (order.whichAtts[i] != input.whichAtts[i] || order.whichTypes[i] != input.whichTypes[i]) {
+			return 0;
+		}
+	}
+	return 1;
+}
+
+void Join::AlignInputOrders (OrderMaker &leftOrder, OrderMaker &rightOrder,
+	OrderMaker &orderL, OrderMaker &orderR, int &sortedL, int &sortedR) {
+
+	sortedL = AlignToInput (leftOrder, orderL, orderR);
+	if (sortedL) {
+		sortedR = IsPrefixOf (orderR, rightOrder);
+	} else {
+		sortedR = AlignToInput (rightOrder, orderR, orderL);
+	}
+}
+
+// reads the next record of a join input, from its group and then its pipe
+static int NextInput (Pipe *pipe, RecordGroup *group, Record &rec) {
+
+	if (group != NULL) {
+		Record *next = group->GetNext ();
+		if (next != NULL) {
+			rec.Copy (next);
+			return 1;
+		}
+	}
+	return pipe != NULL && pipe->Remove (&rec);
+}
+
+void Join::HashJoin (Pipe *buildPipe, RecordGroup *buildGroup, Pipe *probePipe,
+	RecordGroup *probeGroup, int depth, Record *batch, int &batchSize) {
+
+	typedef unordered_multimap<unsigned long, Record *> HashTable;
+	HashTable tables[HASH_JOIN_FANOUT];
+	long long partitionBytes[HASH_JOIN_FANOUT] = {0};
+	RecordGroup *buildSpill[HASH_JOIN_FANOUT] = {NULL};
+	RecordGroup *probeSpill[HASH_JOIN_FANOUT] = {NULL};
+	long long usedBytes = 0;
+	ComparisonEngine comp;
+	Record rec;
+
+	// every level partitions on other bits of the hash
+	int shift = depth * 3;
+
+	while (NextInput (buildPipe, buildGroup, rec)) {
+
+		unsigned long hash = buildOrder->Hash (&rec);
+		if (depth == 0 && filter != NULL) {
+			filter->Add (hash);
+		}
+		int partition = (hash >> shift) % HASH_JOIN_FANOUT;
+		if (buildSpill[partition] != NULL) {
+			buildSpill[partition]->Add (&rec);
+			continue;
+		}
+		long long bytes = ((int *) rec.bits)[0] + sizeof (Record);
+		Record *copy = new Record ();
+		copy->Consume (&rec);
+		tables[partition].insert (make_pair (hash, copy));
+		partitionBytes[partition] += bytes;
+		usedBytes += bytes;
+
+		// spill the largest partitions until the rest fits, keeping one of them;
+		// a partition left alone (one key, say) could not be split any better
+		while (usedBytes > memoryBytes && depth < HASH_JOIN_MAX_DEPTH) {
+
+			int largest = -1, resident = 0;
+			for (int i = 0; i < HASH_JOIN_FANOUT; i++) {
+				if (partitionBytes[i] > 0) {
+					resident++;
+				}
+				if (partitionBytes[i] > 0 && (largest < 0 || partitionBytes[i] > partitionBytes[largest])) {
+					largest = i;
+				}
+			}
+			if (resident < 2) {
+				break;
+			}
+			buildSpill[largest] = new RecordGroup (1);
+			probeSpill[largest] = new RecordGroup (1);
+			for (HashTable::iterator it = tables[largest].begin (); it != tables[largest].end (); it++) {
+				buildSpill[largest]->Add (it->second);
+				delete it->second;
+			}
+			tables[largest].clear ();
+			usedBytes -= partitionBytes[largest];
+			partitionBytes[largest] = 0;
+		}
+	}
+
+	if (depth == 0 && filter != NULL) {
+		filter->Publish (*probeOrder);
+	}
+
+	while (NextInput (probePipe, probeGroup, rec)) {
+
+		unsigned long hash = probeOrder->Hash (&rec);
+		int partition = (hash >> shift) % HASH_JOIN_FANOUT;
+		if (probeSpill[partition] != NULL) {
+			probeSpill[partition]->Add (&rec);
+			continue;
+		}
+		pair<HashTable::iterator, HashTable::iterator> matches = tables[partition].equal_range (hash);
+		for (HashTable::iterator it = matches.first; it != matches.second; it++) {
+			Record *left = buildLeft ? it->second : &rec;
+			Record *right = buildLeft ? &rec : it->second;
+			if (comp.Compare (left, right, literal, selOp)) {
+				Emit (left, right, batch, batchSize);
+			}
+		}
+	}
+
+	for (int i = 0; i < HASH_JOIN_FANOUT; i++) {
+		for (HashTable::iterator it = tables[i].begin (); it != tables[i].end (); it++) {
+			delete it->second;
+		}
+	}
+
+	for (int i = 0; i < HASH_JOIN_FANOUT; i++) {
+
+		if (buildSpill[i] == NULL) {
+			continue;
+		}
+		if (!probeSpill[i]->IsEmpty ()) {
+			buildSpill[i]->MoveFirst ();
+			probeSpill[i]->MoveFirst ();
+			HashJoin (NULL, buildSpill[i], NULL, probeSpill[i], depth + 1, batch, batchSize);
+		}
+		delete buildSpill[i];
+		delete probeSpill[i];
+	}
+}
+
+void Join::NestedLoopJoin (Record *batch, int &batchSize) {
+
+	ComparisonEngine comp;
+	// one page of memory is left for reading the right input back
+	int blockPages = runLength > 1 ? runLength - 1 : 1;
+	vector<Page *> block;
+	for (int i = 0; i < blockPages; i++) {
+		block.push_back (new Page ());
+	}
+	vector<Record *> outer, pageRecords, inner;
+	Record rec;
+	int hasOuter = inPipeL->Remove (&rec);
+
+	char *innerPath = Utilities::newRandomFileName (".bin");
+	DBFile innerFile;
+	innerFile.Create (innerPath, heap, NULL);
+	bool spooled = false;
+	Page innerPage;
+
+	while (hasOuter) {
+
+		int numPages = 1;
+		block[0]->EmptyItOut ();
+		while (hasOuter) {
+			if (!block[numPages - 1]->Append (&rec)) {
+				if (numPages == blockPages) {
+					break;
+				}
+				block[numPages++]->EmptyItOut ();
+				continue;
+			}
+			hasOuter = inPipeL->Remove (&rec);
+		}
+		outer.clear ();
+		for (int i = 0; i < numPages; i++) {
+			block[i]->GetRecords (pageRecords);
+			outer.insert (outer.end (), pageRecords.begin (), pageRecords.end ());
+		}
+
+		if (!spooled) {
+
+			// the first block is matched while the right input is spooled
+			Record right;
+			while (inPipeR->Remove (&right)) {
+				for (int i = 0; i < outer.size (); i++) {
+					if (comp.Compare (outer[i], &right, literal, selOp)) {
+						Emit (outer[i], &right, batch, batchSize);
+					}
+				}
+				innerFile.Add (right);
+			}
+			spooled = true;
+			continue;
+		}
+
+		innerFile.MoveFirst ();
+		while (innerFile.GetNextPage (innerPage)) {
+			innerPage.GetRecords (inner);
+			for (int j = 0; j < inner.size (); j++) {
+				for (int i = 0; i < outer.size (); i++) {
+					if (comp.Compare (outer[i], inner[j], literal, selOp)) {
+						Emit (outer[i], inner[j], batch, batchSize);
+					}
+				}
+			}
+		}
+	}
+
+	// with no left records the right input is only drained
+	if (!spooled) {
+		while (inPipeR->Remove (&rec)) {
+		}
+	}
+	for (int i = 0; i < blockPages; i++) {
+		delete block[i];
+	}
+	innerFile.Close ();
+	string prefPath = string (innerPath, strlen (innerPath) - 4) + ".pref";
+	remove (innerPath);
+	remove (prefPath.c_str ());
+	delete [] innerPath;
+}
+
+// orders records on their join attributes
+class JoinKeyOrder {
+
+	OrderMaker *order;
+	ComparisonEngine comp;
+
+	public:
+
+	JoinKeyOrder (OrderMaker *order) : order (order) {}
+	bool operator() (Record *left, Record *right) {
+		return comp.Compare (left, right, order) < 0;
+	}
+};
+
+void Join::IndexJoin (OrderMaker &orderL, OrderMaker &orderR, Record *batch, int &batchSize) {
+
+	// a left record is the literal of the probe selecting its right records
+	CNF probe;
+	probe.GrowFromSortOrders (orderR, orderL);
+	ComparisonEngine comp;
+	long long blockBytes = (long long) runLength * PAGE_SIZE;
+	vector<Record *> outer, matches;
+	Record rec;
+	int hasOuter = inPipeL->Remove (&rec);
+
+	while (hasOuter) {
+
+		long long bytes = 0;
+		while (hasOuter && bytes < blockBytes) {
+			bytes += ((int *) rec.bits)[0] + sizeof (Record);
+			Record *copy = new Record ();
+			copy->Consume (&rec);
+			outer.push_back (copy);
+			hasOuter = inPipeL->Remove (&rec);
+		}
+		sort (outer.begin (), outer.end (), JoinKeyOrder (&orderL));
+
+		for (int i = 0; i < outer.size (); i++) {
+
+			// left records with the key of the one before reuse its matches
+			if (i == 0 || comp.Compare (outer[i - 1], outer[i], &orderL) != 0) {
+				for (int j = 0; j < matches.size (); j++) {
+					delete matches[j];
+				}
+				matches.clear ();
+				inFileR->MoveFirst ();
+				Record *match = new Record ();
+				while (inFileR->GetNext (*match, probe, *outer[i])) {
+					if (comp.Compare (match, literalR, selFileR)) {
+						matches.push_back (match);
+						match = new Record ();
+					}
+				}
+				delete match;
+			}
+			for (int j = 0; j < matches.size (); j++) {
+				if (comp.Compare (outer[i], matches[j], literal, selOp)) {
+					Emit (outer[i], matches[j], batch, batchSize);
+				}
+			}
+		}
+
+		for (int i = 0; i < outer.size (); i++) {
+			delete outer[i];
+		}
+		outer.clear ();
+	}
+	for (int j = 0; j < matches.size (); j++) {
+		delete matches[j];
+	}
+}
+
+void Join::RadixJoin (Pipe *buildPipe, Pipe *probePipe, Record *batch, int &batchSize) {
+
+	RadixHashTable table;
+	Record rec;
+	while (buildPipe->Remove (&rec)) {
+
+		Record *copy = new Record ();
+		copy->Consume (&rec);
+		table.Add (buildOrder->Hash (copy), copy);
+		if (table.GetNumBytes () > memoryBytes) {
+
+			// the build input does not fit, hash join it with spilling instead;
+			// the hash join adds every build key to the filter
+			RecordGroup built (1);
+			for (int i = 0; i < table.GetNumEntries (); i++) {
+				built.Add (table.GetRecord (i));
+			}
+			built.MoveFirst ();
+			HashJoin (buildPipe, &built, probePipe, NULL, 0, batch, batchSize);
+			return;
+		}
+	}
+
+	if (filter != NULL) {
+		for (int i = 0; i < table.GetNumEntries (); i++) {
+			filter->Add (table.GetHash (i));
+		}
+		filter->Publish (*probeOrder);
+	}
+
+	int numThreads = sysconf (_SC_NPROCESSORS_ONLN);
+	table.Build (numThreads);
+	radixTable = &table;
+	Record *chunk = new Record[RADIX_PROBE_CHUNK];
+	int numPartitions = 1 << table.GetBits ();
+	if (numThreads > numPartitions) {
+		numThreads = numPartitions;
+	}
+	vector<pthread_t> workers (numThreads);
+
+	while (true) {
+
+		int chunkSize = 0, removed;
+		while (chunkSize < RADIX_PROBE_CHUNK &&
+			(removed = probePipe->Remove (chunk + chunkSize, RADIX_PROBE_CHUNK - chunkSize)) > 0) {
+			chunkSize += removed;
+		}
+		if (chunkSize == 0) {
+			break;
+		}
+		if (table.GetNumEntries () == 0) {
+			continue;
+		}
+		if (buildLeft) {
+			PrepareOutput (table.GetRecord (0), chunk);
+		} else {
+			PrepareOutput (chunk, table.GetRecord (0));
+		}
+
+		probeEntries.resize (chunkSize);
+		for (int i = 0; i < chunkSize; i++) {
+			probeEntries[i].hash = probeOrder->Hash (chunk + i);
+			probeEntries[i].rec = chunk + i;
+		}
+		RadixHashTable::Partition (probeEntries, table.GetBits (), probeStarts);
+		nextProbePartition = 0;
+		for (int i = 0; i < numThreads; i++) {
+			pthread_create (&workers[i], NULL, Join::ProbeWorker, this);
+		}
+		for (int i = 0; i < numThreads; i++) {
+			pthread_join (workers[i], NULL);
+		}
+	}
+	delete [] chunk;
+}
+
+void *Join::ProbeWorker (void *arg) {
+
+	Join *op = (Join *) arg;
+	RadixHashTable *table = op->radixTable;
+	ComparisonEngine comp;
+	Record *batch = new Record[OUTPUT_BATCH];
+	int batchSize = 0;
+	int numPartitions = op->probeStarts.size () - 1;
+
+	for (int p = op->nextProbePartition++; p < numPartitions; p = op->nextProbePartition++) {
+
+		for (int i = op->probeStarts[p]; i < op->probeStarts[p + 1]; i++) {
+
+			unsigned long hash = op->probeEntries[i].hash;
+			Record *probe = op->probeEntries[i].rec;
+			for (int entry = table->GetFirst (hash); entry >= 0; entry = table->GetNext (entry, hash)) {
+				Record *left = op->buildLeft ? table->GetRecord (entry) : probe;
+				Record *right = op->buildLeft ? probe : table->GetRecord (entry);
+				if (comp.Compare (left, right, op->literal, op->selOp)) {
+					op->Emit (left, right, batch, batchSize);
+				}
+			}
+		}
+	}
+
+	if (batchSize > 0) {
+		op->outPipe->Insert (batch, batchSize);
+	}
+	delete [] batch;
+	return NULL;
+}
+
+void Join::PrepareOutput (Record *left, Record *right) {
+
+	if (attsToKeep != NULL) {
+		return;
+	}
+	numAttsLeft = ((int *) left->bits)[1] / sizeof (int) - 1;
+	numAttsRight = ((int *) right->bits)[1] / sizeof (int) - 1;
+	attsToKeep = new int[numAttsLeft + numAttsRight];
+	for (int i = 0; i < numAttsLeft; i++) {
+		attsToKeep[i] = i;
+	}
+	for (int i = 0; i < numAttsRight; i++) {
+		attsToKeep[numAttsLeft + i] = i;
+	}
+}
+
+void Join::Emit (Record *left, Record *right, Record *batch, int &batchSize) {
+
+	PrepareOutput (left, right);
+	batch[batchSize++].MergeRecords (left, right, numAttsLeft, numAttsRight,
+		attsToKeep, numAttsLeft + numAttsRight, numAttsLeft);
+	if (batchSize == OUTPUT_BATCH) {
+		outPipe->Insert (batch, batchSize);
+		batchSize = 0;
+	}
+}
+
+void Join::WaitUntilDone () {
+	pthread_join (thread, NULL);
+}
+
+void Join::Use_n_Pages (int runlen) {
+	runLength = runlen > 0 ? runlen : 1;
+}
+
+void Join::Use_Method (JoinMethod method, int buildLeft) {
+	this->method = method;
+	this->buildLeft = buildLeft;
+}
+
+void Join::Use_Input_Orders (OrderMaker &leftOrder, OrderMaker &rightOrder) {
+	inputOrderL = &leftOrder;
+	inputOrderR = &rightOrder;
+}
 
+void Join::Use_Filter (JoinFilter &filter) {
+	this->filter = &filter;
 }
@@ -5,29 +5,123 @@
 #include "DBFile.h"
 #include "Record.h"
 #include "Function.h"
+#include "MemoryGovernor.h"
+#include "RadixHashTable.h"
 
 class RelationalOp {
+	protected:
+	// shared query memory budget, NULL if only Use_n_Pages was given
+	MemoryGovernor *governor;
+	int memoryId;
+
 	public:
+	RelationalOp () : governor (NULL), memoryId (-1) {}
+
 	// blocks the caller until the particular relational operator 
 	// has run to completion
 	virtual void WaitUntilDone () = 0;
 
 	// tell us how much internal memory the operation can use
 	virtual void Use_n_Pages (int n) = 0;
+
+	// tell us which account of the query memory budget the operation
+	// draws from; memory is then asked for and given back as it runs
+	void Use_Memory_Governor (MemoryGovernor *governor, int memoryId) {
+		this->governor = governor;
+		this->memoryId = memoryId;
+	}
+};
+
+// records an operator collects before pushing them into its out pipe
+#define OUTPUT_BATCH 256
+
+// bits a join filter spends on every build record, and the bits of its
+// 512 bit block it sets for every key; with these about 1% of the probe
+// records without a match get through
+#define JOIN_FILTER_BITS_PER_KEY 10
+#define JOIN_FILTER_HASHES 6
+#define JOIN_FILTER_FALSE_RATE 0.01
+
+// A Bloom filter on the join keys of the build input of a join, passed
+// sideways to the scan of its probe input so that the probe records
+// without a match are dropped as they are read. The join adds the hashes
+// of its build keys and publishes the filter once it has read the whole
+// build input (or disables it, letting everything through); the scan
+// waits for that before it reads anything. Every key sets its bits in one
+// cache line sized block, so a test costs one cache miss.
+class JoinFilter {
+
+	private:
+	// hashes of the build keys, until the filter is published
+	vector<unsigned long> keys;
+	// blocks of eight words
+	vector<unsigned long> blocks;
+	OrderMaker probeOrder;
+	int published;
+	int disabled;
+	pthread_mutex_t lock;
+	pthread_cond_t ready;
+
+	// counts of the probe records tested, and dropped
+	long long probed;
+	long long dropped;
+
+	public:
+
+	JoinFilter ();
+	~JoinFilter ();
+
+	// adds the hash of a build key, as given by OrderMaker::Hash
+	void Add (unsigned long hash);
+
+	// builds the filter from the keys added; probe records are then tested on
+	// probeOrder. Once published or disabled, the filter does not change
+	void Publish (OrderMaker &probeOrder);
+	void Disable ();
+
+	// blocks the caller until the filter is published or disabled
+	void WaitUntilReady ();
+
+	// returns 0 if the key of the probe record is surely not a build key
+	int Pass (Record *rec);
+
+	long long GetProbed ();
+	long long GetDropped ();
+
 };
 
+// Scans a file with the CNF on a thread of its own. Sorted files and heap
+// files with secondary indexes are read with GetNext, which searches them
+// on the CNF; other heap files are read page by page, with the next
+// Use_n_Pages pages read ahead in the background. A scan given a
+// JoinFilter by Use_Filter waits for it and drops the records it rejects.
 class SelectFile : public RelationalOp { 
 
 	private:
-	// pthread_t thread;
-	// Record *buffer;
+	pthread_t thread;
+	DBFile *inFile;
+	Pipe *outPipe;
+	CNF *selOp;
+	Record *literal;
+	// pages read ahead of the scan
+	int readAhead;
+	JoinFilter *filter;
+
+	static void *Work (void *arg);
+	// scans the pages of a heap file directly
+	void ScanPages (File *pageFile, off_t numPages, Record *batch);
 
 	public:
 
+	SelectFile () : readAhead (1), filter (NULL) {}
+
 	void Run (DBFile &inFile, Pipe &outPipe, CNF &selOp, Record &literal);
 	void WaitUntilDone ();
 	void Use_n_Pages (int n);
 
+	// tell us the filter of the join that probes with our output
+	void Use_Filter (JoinFilter &filter);
+
 };
 
 class SelectPipe : public RelationalOp {
@@ -42,11 +136,184 @@ class Project : public RelationalOp {
 	void WaitUntilDone () { }
 	void Use_n_Pages (int n) { }
 };
+// records buffered between a join and the sorts of its inputs
+#define JOIN_PIPE_SIZE 100
+
+// Holds a group of records that is read over and over, such as the right
+// records of one join key. The first maxPages pages stay in memory and the
+// rest are spilled to a temporary file.
+class RecordGroup {
+
+	private:
+	vector<Page *> pages;
+	int maxPages;
+	File spillFile;
+	char *spillPath;
+	off_t spilledPages;
+
+	// position of GetNext: page number (memory pages first), then record
+	off_t currentPage;
+	Page spillPage;
+	vector<Record *> currentRecords;
+	int currentRecord;
+
+	public:
+
+	RecordGroup (int maxPages);
+	~RecordGroup ();
+
+	// consumes the record
+	void Add (Record *addMe);
+	void Clear ();
+	int IsEmpty ();
+
+	// returns the next record of the group, NULL at the end; the record
+	// stays owned by the group and is valid until the group changes
+	void MoveFirst ();
+	Record *GetNext ();
+
+};
+
+// partitions a hybrid hash join splits its inputs into at every level,
+// and the levels it recurses before building a partition whatever its size
+#define HASH_JOIN_FANOUT 8
+#define HASH_JOIN_MAX_DEPTH 8
+
+// probe records a radix hash join partitions and probes with at once
+#define RADIX_PROBE_CHUNK 65536
+
+// how a Join matches its inputs
+typedef enum {SortMerge, HybridHash, RadixHash, BlockNestedLoop, IndexNestedLoop} JoinMethod;
+
+// Joins two pipes on a thread of its own, with the method chosen by
+// Use_Method; joins without an equality are always run by BlockNestedLoop.
+// Run with a file on the right instead of a pipe always joins by
+// IndexNestedLoop.
+//
+// SortMerge sorts both inputs with BigQ on the equality attributes of the
+// CNF, each with half of Use_n_Pages but one page, and merges them. An
+// input that Use_Input_Orders says already arrives sorted on them is not
+// sorted again. The right records of one key are collected in a
+// RecordGroup of the pages the sorts leave (at least one) and every left
+// record of the key is matched with it. With a memory governor the pages
+// are those of the join's share; the group takes its part before the
+// sorts start and each sort plans with its own half.
+//
+// HybridHash builds a hash table on one input and probes it with the
+// other. When the build input outgrows Use_n_Pages pages, the largest
+// partitions of the table are spilled, together with the probe records
+// that hash to them, and joined one level deeper; one partition always
+// stays resident.
+//
+// RadixHash keeps the whole build input in a RadixHashTable, whose
+// partitions fit in the L2 cache, and probes it with chunks of
+// RADIX_PROBE_CHUNK records partitioned the same way, one partition per
+// thread at a time. A build input that outgrows Use_n_Pages pages is
+// handed over to HybridHash.
+//
+// BlockNestedLoop loads Use_n_Pages - 1 pages of left records at a time
+// and matches every right record with the whole block. The right input
+// is spooled to a temporary heap DBFile while it is matched with the
+// first block, and read back from it, a page at a time, for the others.
+//
+// Given a JoinFilter by Use_Filter, a hash join adds the keys of its build
+// input and a sort-merge join those of its left input, which it reads
+// through to its sort before the right input; the filter is published for
+// the scan of the other input once they have all been read. A sort-merge
+// join whose left input needs no sort, and the nested-loop joins, disable
+// it.
+//
+// IndexNestedLoop reads Use_n_Pages pages of left records at a time,
+// sorts them on the join attributes and, for every distinct key, seeks the
+// right file to its matching records with GetNext: a binary search of a
+// sorted file, a descent of a B+-tree or an index probe of a heap file.
+// Probing in key order reads the pages of the file roughly in order.
 class Join : public RelationalOp { 
+
+	private:
+	pthread_t thread;
+	Pipe *inPipeL;
+	Pipe *inPipeR;
+	Pipe *outPipe;
+	CNF *selOp;
+	Record *literal;
+	// right file of an index nested-loop join and its own selection
+	DBFile *inFileR;
+	CNF *selFileR;
+	Record *literalR;
+	int runLength;
+	JoinMethod method;
+	int buildLeft;
+	// orders the inputs arrive in, NULL if unknown
+	OrderMaker *inputOrderL;
+	OrderMaker *inputOrderR;
+	// filter on the build keys for the scan of the probe input, NULL if none
+	JoinFilter *filter;
+
+	// attributes of the output records, set from the first match
+	int *attsToKeep;
+	int numAttsLeft;
+	int numAttsRight;
+
+	// state of a hash join
+	OrderMaker *buildOrder;
+	OrderMaker *probeOrder;
+	long long memoryBytes;
+
+	// state of a radix hash join: the probe chunk, partitioned like the
+	// table, and the partition of it the next thread takes
+	RadixHashTable *radixTable;
+	vector<RadixEntry> probeEntries;
+	vector<int> probeStarts;
+	atomic<int> nextProbePartition;
+
+	static void *Work (void *arg);
+	void MergeJoin (OrderMaker &orderL, OrderMaker &orderR);
+	// joins the build input with the probe input, each read from a group of
+	// records (a partition spilled by the level above) and then from a pipe
+	void HashJoin (Pipe *buildPipe, RecordGroup *buildGroup, Pipe *probePipe,
+		RecordGroup *probeGroup, int depth, Record *batch, int &batchSize);
+	void NestedLoopJoin (Record *batch, int &batchSize);
+	void IndexJoin (OrderMaker &orderL, OrderMaker &orderR, Record *batch, int &batchSize);
+	void RadixJoin (Pipe *buildPipe, Pipe *probePipe, Record *batch, int &batchSize);
+	static void *ProbeWorker (void *arg);
+	// sets the attributes of the output records from a pair of input records
+	void PrepareOutput (Record *left, Record *right);
+	// merges the two records into batch[batchSize] and flushes a full batch
+	void Emit (Record *left, Record *right, Record *batch, int &batchSize);
+
 	public:
-	void Run (Pipe &inPipeL, Pipe &inPipeR, Pipe &outPipe, CNF &selOp, Record &literal) { }
-	void WaitUntilDone () { }
-	void Use_n_Pages (int n) { }
+
+	Join () : inFileR (NULL), runLength (1), method (SortMerge), buildLeft (0),
+		inputOrderL (NULL), inputOrderR (NULL), filter (NULL), attsToKeep (NULL) {}
+
+	void Run (Pipe &inPipeL, Pipe &inPipeR, Pipe &outPipe, CNF &selOp, Record &literal);
+
+	// probes the right file, which must be open, for the left records;
+	// the right records are also selected with selFileR and literalR
+	void Run (Pipe &inPipeL, DBFile &inFileR, CNF &selFileR, Record &literalR,
+		Pipe &outPipe, CNF &selOp, Record &literal);
+	void WaitUntilDone ();
+	void Use_n_Pages (int n);
+
+	// tell us how to join; a hash join builds its table on the left input
+	// when buildLeft is set and on the right one otherwise
+	void Use_Method (JoinMethod method, int buildLeft);
+
+	// tell us the orders the inputs arrive in (no attributes if none), so
+	// that a sort-merge join sorts only the inputs that need it
+	void Use_Input_Orders (OrderMaker &leftOrder, OrderMaker &rightOrder);
+
+	// tell us the filter to build for the scan of the probe input, the right
+	// input of a sort-merge join
+	void Use_Filter (JoinFilter &filter);
+
+	// reorders the pairs of join attributes, orderL and orderR as given by
+	// CNF::GetSortOrders, to follow the order of a sorted input, and tells
+	// which inputs then arrive sorted on them
+	static void AlignInputOrders (OrderMaker &leftOrder, OrderMaker &rightOrder,
+		OrderMaker &orderL, OrderMaker &orderR, int &sortedL, int &sortedR);
+
 };
 class DuplicateRemoval : public RelationalOp {
 	public:
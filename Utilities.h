@@ -2,6 +2,7 @@
 #include "iostream"
 #include "fstream"
 #include <string.h>
+#include <pthread.h>
 
 /**
  *  class for defining utility functions to be used
@@ -19,6 +20,9 @@ class Utilities {
 
         // get's a unique random int counter value
         static int getNextCounter () {
+            // sorts of one query may ask for a name at the same time
+            static pthread_mutex_t counterMutex = PTHREAD_MUTEX_INITIALIZER;
+            pthread_mutex_lock(&counterMutex);
             ifstream ifile;
             ofstream ofile;
             int counter = 0;
@@ -31,11 +35,12 @@ class Utilities {
             ofile.open("counter.txt",ios::out);
             ofile.write((char*)&counter,sizeof(int));
             ofile.close();
+            pthread_mutex_unlock(&counterMutex);
             return counter;
         }   
 
         // returns a char* new random file name with given extension
-        static char* newRandomFileName(char* extension) {
+        static char* newRandomFileName(const char* extension) {
             if ((extension == NULL) || (extension[0] == '\0')) { extension=""; }
             string str("temp_" + to_string(Utilities::getNextCounter()) + extension);
             char *cstr = new char[str.length() + 1];
@@ -1,12 +1,21 @@
 #include <string>
 #include <fstream>
+#include <map>
+#include <unistd.h>
 #include "DBFile.h"
 #include "Statistics.h"
+#include "PageCodec.h"
+#include "MemoryGovernor.h"
+#include "FenceIndex.h"
+#include "ParallelScan.h"
+#include "RelOp.h"
 #include <gtest/gtest.h>
 
 extern "C" struct YY_BUFFER_STATE *yy_scan_string(const char*);
 extern "C" int yyparse(void);
 extern struct AndList *final;
+extern struct NameList *orderingAtts;
+extern int limitCount;
 
 class FilePath{
     public:
@@ -15,6 +24,67 @@ class FilePath{
     const std::string catalog_path = "catalog";
 };
 
+// the (key, pad) records most of the file tests use: an Int key that sorted,
+// tree and hash files are ordered on and a String pad to fill the pages.
+// The files of a table are named after it and removed with it.
+static Attribute keyPadAtts[2] = {{(char *) "key", Int}, {(char *) "pad", String}};
+
+class KeyPadTable {
+    std::string name;
+public:
+    std::string pad;
+    Schema schema;
+    OrderMaker order;
+    SortedStartUp startup;
+
+    KeyPadTable(const char *name, int padLength, int runLength = 2)
+        : name(name), pad(padLength, 'p'), schema((char *) name, 2, keyPadAtts) {
+        order.numAtts = 1;
+        order.whichAtts[0] = 0;
+        order.whichTypes[0] = Int;
+        startup.o = &order;
+        startup.l = runLength;
+        startup.policy = tiered;
+        Remove();
+    }
+    ~KeyPadTable() {
+        Remove();
+    }
+    void Remove() {
+        system(("rm -f " + name + ".*").c_str());
+    }
+    // creates the file of the table, ordered on the key unless it is a heap
+    int Create(DBFile &dbfile, fType type) {
+        return dbfile.Create((name + ".bin").c_str(), type, type == heap ? NULL : &startup);
+    }
+    int Open(DBFile &dbfile) {
+        return dbfile.Open((name + ".bin").c_str());
+    }
+    void Compose(Record &rec, int key) {
+        std::string text = std::to_string(key) + "|" + pad + "|";
+        rec.ComposeRecord(&schema, text.c_str());
+    }
+    // adds numRecords records with keys (i * step) % numKeys; a file is read
+    // every moveFirstEvery records, which gives a sorted file segments
+    void Fill(Pipe &pipe, int numRecords, int numKeys, int step = 7919) {
+        for (int i = 0; i < numRecords; i++) {
+            Record rec;
+            Compose(rec, (int) (((long) i * step) % numKeys));
+            pipe.Insert(&rec);
+        }
+    }
+    void Fill(DBFile &dbfile, int numRecords, int numKeys, int step = 7919, int moveFirstEvery = 0) {
+        for (int i = 0; i < numRecords; i++) {
+            Record rec;
+            Compose(rec, (int) (((long) i * step) % numKeys));
+            dbfile.Add(rec);
+            if (moveFirstEvery > 0 && i % moveFirstEvery == moveFirstEvery - 1) {
+                dbfile.MoveFirst();
+            }
+        }
+    }
+};
+
 
 TEST(QueryTesting, estimate) {
     Statistics s;
@@ -58,6 +128,1356 @@ TEST(QueryTesting, apply) {
 	ASSERT_NEAR(3400000,result,0.1);
 }
 
+TEST(QueryTesting, orderByLimitParses) {
+	char *query = "SELECT l_orderkey FROM lineitem AS l WHERE (l_quantity > 10) ORDER BY l_extendedprice, l_orderkey LIMIT 5";
+	yy_scan_string(query);
+	ASSERT_EQ(0, yyparse());
+	ASSERT_STREQ("l_extendedprice", orderingAtts->name);
+	ASSERT_STREQ("l_orderkey", orderingAtts->next->name);
+	ASSERT_EQ(NULL, orderingAtts->next->next);
+	ASSERT_EQ(5, limitCount);
+
+	// ORDER BY alone keeps every record
+	query = "SELECT l_orderkey FROM lineitem AS l WHERE (l_quantity > 10) ORDER BY l_orderkey";
+	yy_scan_string(query);
+	ASSERT_EQ(0, yyparse());
+	ASSERT_STREQ("l_orderkey", orderingAtts->name);
+	ASSERT_EQ(0, limitCount);
+}
+
+TEST(SortTesting, topKKeepsFirstRecords) {
+    KeyPadTable table("topktest", 200);
+
+    // a limit below the input size, and one above it
+    int limits[2] = {100, 20000};
+    int expected[2] = {100, 10000};
+    for (int l = 0; l < 2; l++) {
+        SortOptions options;
+        options.limit = limits[l];
+        Pipe in(100), out(100);
+        BigQ sorter(in, out, table.order, 1, options);
+        table.Fill(in, 10000, 10000);
+        in.ShutDown();
+        Record rec;
+        int count = 0;
+        while (out.Remove(&rec)) {
+            ASSERT_EQ(count, *((int *) (rec.bits + ((int *) rec.bits)[1])));
+            count++;
+        }
+        BigQStats stats = sorter.GetStats();
+        ASSERT_EQ(expected[l], count);
+        ASSERT_EQ(10000, stats.recordsIn);
+        ASSERT_EQ(expected[l], stats.recordsOut);
+        // the records are kept in memory, even more than a run of one page holds
+        ASSERT_EQ(0, stats.runs);
+        ASSERT_EQ(0, stats.spillBytesWritten);
+    }
+}
+
+TEST(SortTesting, pageCodecRoundTrip) {
+    // a page image with lots of repetition, as sorted runs usually have
+    int length = 100000;
+    char *page = new char[length];
+    for (int i = 0; i < length; i++) {
+        page[i] = (i % 512 < 64) ? (char) (i * 7) : "l_returnflag|R|"[i % 15];
+    }
+    char *compressed = new char[PageCodec::MaxCompressedLength(length)];
+    char *decompressed = new char[length];
+    int compressedLength = PageCodec::Compress(page, length, compressed);
+    ASSERT_LT(compressedLength, length);
+    ASSERT_EQ(length, PageCodec::Decompress(compressed, compressedLength, decompressed, length));
+    ASSERT_EQ(0, memcmp(page, decompressed, length));
+    delete [] page;
+    delete [] compressed;
+    delete [] decompressed;
+}
+
+TEST(SortTesting, compressedRunsSortInOrder) {
+    KeyPadTable table("codectest", 200);
+
+    // every key comes twice; folding duplicates leaves runs of varying length
+    SortMode modes[2] = {SortAll, RemoveDuplicates};
+    int expected[2] = {10000, 5000};
+    for (int m = 0; m < 2; m++) {
+        SortOptions options;
+        options.compressRuns = true;
+        options.mode = modes[m];
+        Pipe in(100), out(100);
+        BigQ sorter(in, out, table.order, 2, options);
+        table.Fill(in, 10000, 5000);
+        in.ShutDown();
+        Record rec;
+        int count = 0, lastKey = -1;
+        while (out.Remove(&rec)) {
+            int key = *((int *) (rec.bits + ((int *) rec.bits)[1]));
+            ASSERT_LE(lastKey, key);
+            ASSERT_EQ(table.pad, std::string(rec.bits + ((int *) rec.bits)[2]));
+            lastKey = key;
+            count++;
+        }
+        BigQStats stats = sorter.GetStats();
+        ASSERT_EQ(expected[m], count);
+        ASSERT_EQ(expected[m], stats.recordsOut);
+        ASSERT_GT(stats.runs, 1);
+        // the padding compresses well and every stored byte is read back once
+        ASSERT_LT(stats.spillBytesWritten * 4, stats.spillBytesRaw);
+        ASSERT_EQ(stats.spillBytesWritten, stats.spillBytesRead);
+    }
+}
+
+TEST(SortTesting, memoryGovernorShares) {
+    MemoryGovernor governor(4 * PAGE_SIZE);
+    int small = governor.Register(1);
+    int large = governor.Register(3);
+    ASSERT_EQ(PAGE_SIZE, governor.GetShare(small));
+    ASSERT_EQ(3 * PAGE_SIZE, governor.GetShare(large));
+    // the share of the other operator is kept for it
+    ASSERT_EQ(PAGE_SIZE, governor.Acquire(small, 4 * PAGE_SIZE, PAGE_SIZE));
+    ASSERT_EQ(3 * PAGE_SIZE, governor.Acquire(large, 3 * PAGE_SIZE, PAGE_SIZE));
+    // the minimum is granted even over budget and shows up in the peak
+    ASSERT_EQ(PAGE_SIZE, governor.Acquire(small, PAGE_SIZE, PAGE_SIZE));
+    ASSERT_EQ(5 * PAGE_SIZE, governor.GetPeakUsage());
+    governor.Release(small, 2 * PAGE_SIZE);
+    governor.Release(large, 3 * PAGE_SIZE);
+    ASSERT_EQ(0, governor.GetUsage());
+}
+
+TEST(SortTesting, statsReportSpilledRuns) {
+    KeyPadTable table("statstest", 200);
+
+    // about 2.4 MB of records sorted in runs of two pages
+    Pipe in(100), out(100);
+    BigQ sorter(in, out, table.order, 2);
+    table.Fill(in, 10000, 10000);
+    in.ShutDown();
+    Record rec;
+    int count = 0;
+    while (out.Remove(&rec)) {
+        count++;
+    }
+    BigQStats stats = sorter.GetStats();
+    ASSERT_EQ(10000, count);
+    ASSERT_EQ(10000, stats.recordsIn);
+    ASSERT_EQ(10000, stats.recordsOut);
+    // every run holds at most two pages, all of them merged in one pass
+    ASSERT_GE(stats.runs, 2400000 / (2 * PAGE_SIZE));
+    ASSERT_LE(stats.averageRunLength, 2);
+    ASSERT_EQ(stats.runs, stats.mergeFanIn);
+    ASSERT_EQ(1, stats.mergePasses);
+    // everything spilled is read back once, a whole page each
+    ASSERT_GT(stats.spillBytesWritten, 2000000);
+    ASSERT_GE(stats.spillBytesWritten, stats.spillBytesRaw);
+    ASSERT_EQ(stats.spillBytesWritten, stats.spillBytesRead);
+    ASSERT_GT(stats.comparisons, 0);
+}
+
+TEST(SortTesting, foldingModesSpanRuns) {
+    Attribute atts[3] = {{(char *) "key", Int}, {(char *) "val", Double}, {(char *) "pad", String}};
+    Schema schema((char *) "foldtest", 3, atts);
+    OrderMaker order;
+    order.numAtts = 1;
+    order.whichAtts[0] = 0;
+    order.whichTypes[0] = Int;
+    FuncOperand valOperand = {NAME, (char *) "val"};
+    FuncOperator sumVal = {0, NULL, &valOperand, NULL};
+    Function aggregate;
+    aggregate.GrowFromParseTree(&sumVal, schema);
+
+    // the first half folds to 50 keys and keeps filling its run in memory,
+    // the second half has 5000 distinct keys and spills runs of four pages
+    std::string pad(100, 'f');
+    std::map<int, double> sums;
+    vector<std::string> texts;
+    for (int i = 0; i < 20000; i++) {
+        int key = i < 10000 ? i % 50 : (i * 7) % 5000;
+        double val = (i % 4) * 0.25;
+        sums[key] += val;
+        texts.push_back(std::to_string(key) + "|" + std::to_string(val) + "|" + pad + "|");
+    }
+
+    SortMode modes[2] = {RemoveDuplicates, Aggregate};
+    for (int m = 0; m < 2; m++) {
+        SortOptions options;
+        options.mode = modes[m];
+        options.aggregate = &aggregate;
+        Pipe in(100), out(100);
+        BigQ sorter(in, out, order, 4, options);
+        for (int i = 0; i < texts.size(); i++) {
+            Record rec;
+            rec.ComposeRecord(&schema, texts[i].c_str());
+            in.Insert(&rec);
+        }
+        in.ShutDown();
+
+        // aggregates carry the sum in front of the attributes of the record
+        int first = modes[m] == Aggregate ? 1 : 0;
+        Record rec;
+        int count = 0, lastKey = -1;
+        while (out.Remove(&rec)) {
+            int *bits = (int *) rec.bits;
+            int key = *((int *) (rec.bits + bits[first + 1]));
+            ASSERT_LT(lastKey, key);
+            ASSERT_EQ(pad, std::string(rec.bits + bits[first + 3]));
+            if (modes[m] == Aggregate) {
+                ASSERT_EQ(sums[key], *((double *) (rec.bits + bits[1])));
+            }
+            lastKey = key;
+            count++;
+        }
+        BigQStats stats = sorter.GetStats();
+        ASSERT_EQ(sums.size(), count);
+        ASSERT_GT(stats.runs, 1);
+    }
+}
+
+TEST(SortTesting, mergePassesFoldAggregates) {
+    Attribute atts[3] = {{(char *) "key", Int}, {(char *) "val", Double}, {(char *) "pad", String}};
+    Schema schema((char *) "passtest", 3, atts);
+    OrderMaker order;
+    order.numAtts = 1;
+    order.whichAtts[0] = 0;
+    order.whichTypes[0] = Int;
+    FuncOperand valOperand = {NAME, (char *) "val"};
+    FuncOperator sumVal = {0, NULL, &valOperand, NULL};
+    Function aggregate;
+    aggregate.GrowFromParseTree(&sumVal, schema);
+
+    // with three pages the runs are merged two at a time, in several passes
+    MemoryGovernor governor(3 * PAGE_SIZE);
+    SortOptions options;
+    options.mode = Aggregate;
+    options.aggregate = &aggregate;
+    options.governor = &governor;
+    options.memoryId = governor.Register(1);
+    Pipe in(100), out(100);
+    BigQ sorter(in, out, order, 1, options);
+    std::string pad(100, 'a');
+    std::map<int, double> sums;
+    for (int i = 0; i < 40000; i++) {
+        int key = (i * 7919) % 2000;
+        double val = (i % 4) * 0.25;
+        sums[key] += val;
+        std::string text = std::to_string(key) + "|" + std::to_string(val) + "|" + pad + "|";
+        Record rec;
+        rec.ComposeRecord(&schema, text.c_str());
+        in.Insert(&rec);
+    }
+    in.ShutDown();
+
+    Record rec;
+    int count = 0, lastKey = -1;
+    while (out.Remove(&rec)) {
+        int *bits = (int *) rec.bits;
+        int key = *((int *) (rec.bits + bits[2]));
+        ASSERT_LT(lastKey, key);
+        ASSERT_EQ(sums[key], *((double *) (rec.bits + bits[1])));
+        lastKey = key;
+        count++;
+    }
+    BigQStats stats = sorter.GetStats();
+    ASSERT_EQ(sums.size(), count);
+    ASSERT_GT(stats.mergePasses, 1);
+    ASSERT_LE(stats.mergeFanIn, 2);
+    // every intermediate pass folds, so it writes fewer pages than phase 1 did
+    long long phase1Bytes = (long long) (stats.runs * stats.averageRunLength + 0.5) * PAGE_SIZE;
+    ASSERT_LT(stats.spillBytesWritten - phase1Bytes, (stats.mergePasses - 1) * phase1Bytes / 2);
+    ASSERT_EQ(0, governor.GetUsage());
+}
+
+TEST(TreeTesting, insertKeepsSortOrder) {
+    KeyPadTable table("treetest", 500, 4);
+
+    // enough records for the leaves and the root to split
+    DBFile dbfile;
+    ASSERT_EQ(1, table.Create(dbfile, tree));
+    table.Fill(dbfile, 5000, 5000);
+    dbfile.MoveFirst();
+    Record rec;
+    int expected = 0;
+    while (dbfile.GetNext(rec)) {
+        ASSERT_EQ(expected, *((int *) (rec.bits + ((int *) rec.bits)[1])));
+        expected++;
+    }
+    ASSERT_EQ(5000, expected);
+    dbfile.Close();
+}
+
+TEST(TreeTesting, rangeSeeksToFirstKey) {
+    KeyPadTable table("treerange", 500, 4);
+    DBFile dbfile;
+    ASSERT_EQ(1, table.Create(dbfile, tree));
+    table.Fill(dbfile, 5000, 5000);
+
+    // key > 1000 AND key < 1100, key > 4990, key < 10, 5 < key AND key < 8
+    Operand key = {NAME, (char *) "key"};
+    const char *lows[4] = {"1000", "4990", NULL, "5"};
+    const char *highs[4] = {"1100", NULL, "10", "8"};
+    int expected[4] = {99, 9, 10, 2};
+    for (int q = 0; q < 4; q++) {
+        Operand low = {INT, (char *) lows[q]};
+        Operand high = {INT, (char *) highs[q]};
+        ComparisonOp above = {GREATER_THAN, &key, &low};
+        ComparisonOp literalFirst = {LESS_THAN, &low, &key};
+        ComparisonOp below = {LESS_THAN, &key, &high};
+        OrList aboveList = {q == 3 ? &literalFirst : &above, NULL};
+        OrList belowList = {&below, NULL};
+        AndList second = {&belowList, NULL};
+        AndList first = {lows[q] != NULL ? &aboveList : &belowList, highs[q] != NULL && lows[q] != NULL ? &second : NULL};
+        CNF cnf;
+        Record literal;
+        cnf.GrowFromParseTree(&first, &table.schema, literal);
+
+        dbfile.MoveFirst();
+        Record rec;
+        int matches = 0;
+        while (dbfile.GetNext(rec, cnf, literal)) {
+            matches++;
+        }
+        ASSERT_EQ(expected[q], matches);
+    }
+    dbfile.Close();
+}
+
+TEST(SortTesting, segmentsMergeInSortOrder) {
+    KeyPadTable table("segtest", 200);
+
+    // small batches between reads each become a segment of their own
+    DBFile dbfile;
+    ASSERT_EQ(1, table.Create(dbfile, sorted));
+    table.Fill(dbfile, 4000, 4000, 7919, 500);
+    dbfile.Close();
+    ASSERT_EQ(1, table.Open(dbfile));
+    dbfile.MoveFirst();
+    Record rec;
+    int expected = 0;
+    while (dbfile.GetNext(rec)) {
+        ASSERT_EQ(expected, *((int *) (rec.bits + ((int *) rec.bits)[1])));
+        expected++;
+    }
+    ASSERT_EQ(4000, expected);
+    dbfile.Close();
+}
+
+TEST(SortTesting, scanKeepsVersionDuringCompaction) {
+    KeyPadTable table("comptest", 200, 16);
+
+    // even keys become the base file, odd keys a segment as large as it,
+    // which the compaction merges into a new base file in the background
+    DBFile dbfile;
+    ASSERT_EQ(1, table.Create(dbfile, sorted));
+    for (int batch = 0; batch < 2; batch++) {
+        for (int i = 0; i < 40000; i++) {
+            Record rec;
+            table.Compose(rec, ((i * 7919) % 40000) * 2 + batch);
+            dbfile.Add(rec);
+        }
+        dbfile.MoveFirst();
+        if (batch == 0) {
+            dbfile.Close();
+            ASSERT_EQ(1, table.Open(dbfile));
+        }
+    }
+
+    // the scan opens the base file and the segment, then the compaction
+    // swaps in the merged base file and unlinks the segment under it
+    Record rec;
+    ASSERT_EQ(1, dbfile.GetNext(rec));
+    ASSERT_EQ(0, system("ls comptest.*.seg > /dev/null 2>&1"));
+    for (int wait = 0; wait < 600 && system("ls comptest.*.seg > /dev/null 2>&1") == 0; wait++) {
+        usleep(100000);
+    }
+    ASSERT_NE(0, system("ls comptest.*.seg > /dev/null 2>&1"));
+    int expected = 0;
+    do {
+        ASSERT_EQ(expected, *((int *) (rec.bits + ((int *) rec.bits)[1])));
+        expected++;
+    } while (dbfile.GetNext(rec));
+    ASSERT_EQ(80000, expected);
+
+    // a scan opened after the swap reads the merged base file alone
+    dbfile.MoveFirst();
+    expected = 0;
+    while (dbfile.GetNext(rec)) {
+        ASSERT_EQ(expected, *((int *) (rec.bits + ((int *) rec.bits)[1])));
+        expected++;
+    }
+    ASSERT_EQ(80000, expected);
+    dbfile.Close();
+}
+
+TEST(SortTesting, rangeSearchSeeksToBounds) {
+    Attribute atts[3] = {{(char *) "a", Int}, {(char *) "b", Int}, {(char *) "pad", String}};
+    Schema schema((char *) "rangetest", 3, atts);
+    OrderMaker order;
+    order.numAtts = 2;
+    order.whichAtts[0] = 0;
+    order.whichTypes[0] = Int;
+    order.whichAtts[1] = 1;
+    order.whichTypes[1] = Int;
+    SortedStartUp startup = {&order, 4, tiered};
+    system("rm -f rangetest.*");
+
+    // a from 0 to 999, each with b from 0 to 4
+    DBFile dbfile;
+    ASSERT_EQ(1, dbfile.Create("rangetest.bin", sorted, &startup));
+    std::string pad(300, 'r');
+    for (int i = 0; i < 5000; i++) {
+        std::string text = std::to_string((i * 7919) % 1000) + "|" + std::to_string(i / 1000) + "|" + pad + "|";
+        Record rec;
+        rec.ComposeRecord(&schema, text.c_str());
+        dbfile.Add(rec);
+    }
+    dbfile.Close();
+    ASSERT_EQ(1, dbfile.Open("rangetest.bin"));
+
+    Operand a = {NAME, (char *) "a"};
+    Operand b = {NAME, (char *) "b"};
+    Operand v2 = {INT, (char *) "2"};
+    Operand v5 = {INT, (char *) "5"};
+    Operand v10 = {INT, (char *) "10"};
+    Operand v100 = {INT, (char *) "100"};
+    Operand v200 = {INT, (char *) "200"};
+    Operand v500 = {INT, (char *) "500"};
+    Operand v990 = {INT, (char *) "990"};
+    // a > 990, a < 10, 100 < a AND a < 200, 5 < a, a = 500 AND b > 2, a = 500 AND b < 2
+    ComparisonOp comparisons[6][2] = {
+        {{GREATER_THAN, &a, &v990}},
+        {{LESS_THAN, &a, &v10}},
+        {{LESS_THAN, &v100, &a}, {LESS_THAN, &a, &v200}},
+        {{LESS_THAN, &v5, &a}},
+        {{EQUALS, &a, &v500}, {GREATER_THAN, &b, &v2}},
+        {{EQUALS, &a, &v500}, {LESS_THAN, &b, &v2}}};
+    int numComparisons[6] = {1, 1, 2, 1, 2, 2};
+    int lowerAtts[6] = {1, 0, 1, 1, 2, 1};
+    int upperAtts[6] = {0, 1, 1, 0, 1, 2};
+    int expected[6] = {45, 50, 495, 4970, 2, 2};
+    for (int q = 0; q < 6; q++) {
+        OrList orLists[2];
+        AndList andLists[2];
+        for (int c = 0; c < numComparisons[q]; c++) {
+            orLists[c].left = &comparisons[q][c];
+            orLists[c].rightOr = NULL;
+            andLists[c].left = &orLists[c];
+            andLists[c].rightAnd = c + 1 < numComparisons[q] ? &andLists[c + 1] : NULL;
+        }
+        CNF cnf;
+        Record literal;
+        cnf.GrowFromParseTree(andLists, &schema, literal);
+        OrderMaker lower, upper;
+        ASSERT_EQ(1, cnf.GetRangeOrderMakers(order, lower, upper));
+        ASSERT_EQ(lowerAtts[q], lower.numAtts);
+        ASSERT_EQ(upperAtts[q], upper.numAtts);
+
+        dbfile.MoveFirst();
+        Record rec;
+        int matches = 0;
+        while (dbfile.GetNext(rec, cnf, literal)) {
+            matches++;
+        }
+        ASSERT_EQ(expected[q], matches);
+    }
+    dbfile.Close();
+    system("rm -f rangetest.*");
+}
+
+TEST(SortTesting, fenceIndexFindsFirstPage) {
+    Attribute atts[2] = {{(char *) "pad", String}, {(char *) "key", Int}};
+    Schema schema((char *) "fencetest", 2, atts);
+    OrderMaker order;
+    order.numAtts = 1;
+    order.whichAtts[0] = 1;
+    order.whichTypes[0] = Int;
+    // pages starting with keys 0, 10, 10, 20
+    FenceIndex fences(order);
+    int firstKeys[4] = {0, 10, 10, 20};
+    for (int i = 0; i < 4; i++) {
+        std::string text = "p|" + std::to_string(firstKeys[i]) + "|";
+        Record rec;
+        rec.ComposeRecord(&schema, text.c_str());
+        fences.AddPage(rec);
+    }
+    ASSERT_EQ(1, fences.Write("fencetest.fence"));
+    FenceIndex loaded(order);
+    ASSERT_EQ(1, loaded.Read("fencetest.fence"));
+    remove("fencetest.fence");
+    ASSERT_EQ(4, loaded.GetNumPages());
+
+    // the literal holds the key as its only attribute
+    Attribute keyAtt = {(char *) "key", Int};
+    Schema literalSchema((char *) "literal", 1, &keyAtt);
+    OrderMaker queryOrder;
+    queryOrder.numAtts = 1;
+    queryOrder.whichAtts[0] = 0;
+    queryOrder.whichTypes[0] = Int;
+    int keys[5] = {-1, 5, 10, 15, 30};
+    off_t pages[5] = {0, 0, 0, 2, 3};
+    for (int i = 0; i < 5; i++) {
+        std::string text = std::to_string(keys[i]) + "|";
+        Record literal;
+        literal.ComposeRecord(&literalSchema, text.c_str());
+        ASSERT_EQ(pages[i], loaded.LowerBoundPage(literal, queryOrder));
+    }
+}
+
+TEST(HashTesting, probeReadsMatchingKeys) {
+    KeyPadTable table("hashtest", 500, 1);
+
+    // enough records for the buckets to split several times
+    DBFile dbfile;
+    ASSERT_EQ(1, table.Create(dbfile, hashed));
+    table.Fill(dbfile, 6000, 2000, 1);
+    dbfile.Close();
+    ASSERT_EQ(1, table.Open(dbfile));
+
+    Operand left = {NAME, (char *) "key"};
+    Operand right = {INT, (char *) "1234"};
+    ComparisonOp comparison = {EQUALS, &left, &right};
+    OrList orList = {&comparison, NULL};
+    AndList andList = {&orList, NULL};
+    CNF cnf;
+    Record literal;
+    cnf.GrowFromParseTree(&andList, &table.schema, literal);
+    dbfile.MoveFirst();
+    Record rec;
+    int matches = 0;
+    while (dbfile.GetNext(rec, cnf, literal)) {
+        ASSERT_EQ(1234, *((int *) (rec.bits + ((int *) rec.bits)[1])));
+        matches++;
+    }
+    ASSERT_EQ(3, matches);
+    dbfile.Close();
+}
+
+TEST(IndexTesting, probeFetchesRecordsByAddress) {
+    KeyPadTable table("indextest", 200);
+
+    // the index is built over the first records and maintained for the rest
+    DBFile dbfile;
+    ASSERT_EQ(1, table.Create(dbfile, heap));
+    RecordId firstId;
+    for (int i = 0; i < 6000; i++) {
+        if (i == 3000) {
+            ASSERT_EQ(1, dbfile.CreateIndex(table.order));
+        }
+        Record rec;
+        table.Compose(rec, (i * 7919) % 2000);
+        dbfile.Add(rec);
+        if (i == 0) {
+            firstId = dbfile.GetRecordId();
+        }
+    }
+    dbfile.Close();
+    ASSERT_EQ(1, table.Open(dbfile));
+    Record first;
+    ASSERT_EQ(1, dbfile.GetRecord(firstId, first));
+    ASSERT_EQ(0, *((int *) (first.bits + ((int *) first.bits)[1])));
+
+    Operand left = {NAME, (char *) "key"};
+    Operand right = {INT, (char *) "1234"};
+    ComparisonOp comparison = {EQUALS, &left, &right};
+    OrList orList = {&comparison, NULL};
+    AndList andList = {&orList, NULL};
+    CNF cnf;
+    Record literal;
+    cnf.GrowFromParseTree(&andList, &table.schema, literal);
+    dbfile.MoveFirst();
+    Record rec;
+    int matches = 0;
+    while (dbfile.GetNext(rec, cnf, literal)) {
+        ASSERT_EQ(1234, *((int *) (rec.bits + ((int *) rec.bits)[1])));
+        matches++;
+    }
+    ASSERT_EQ(3, matches);
+
+    // a scan started without the CNF goes on from where it is
+    int later = 0;
+    for (int i = 3000; i < 6000; i++) {
+        if ((i * 7919) % 2000 == 1234) {
+            later++;
+        }
+    }
+    dbfile.MoveFirst();
+    for (int i = 0; i < 3000; i++) {
+        ASSERT_EQ(1, dbfile.GetNext(rec));
+    }
+    matches = 0;
+    while (dbfile.GetNext(rec, cnf, literal)) {
+        ASSERT_EQ(1234, *((int *) (rec.bits + ((int *) rec.bits)[1])));
+        matches++;
+    }
+    ASSERT_EQ(later, matches);
+    dbfile.Close();
+}
+
+TEST(IndexTesting, sortedProjectionAnswersAlone) {
+    Attribute atts[2] = {{(char *) "pad", String}, {(char *) "key", Int}};
+    Schema schema((char *) "projtest", 2, atts);
+    OrderMaker order;
+    order.numAtts = 1;
+    order.whichAtts[0] = 1;
+    order.whichTypes[0] = Int;
+    SortedStartUp startup = {&order, 2, tiered};
+    system("rm -f projtest.*");
+
+    // two batches, so that the scan merges the projections of two files
+    DBFile dbfile;
+    ASSERT_EQ(1, dbfile.Create("projtest.bin", sorted, &startup));
+    std::string pad(200, 'p');
+    for (int i = 0; i < 2000; i++) {
+        std::string text = pad + "|" + std::to_string((i * 7919) % 2000) + "|";
+        Record rec;
+        rec.ComposeRecord(&schema, text.c_str());
+        dbfile.Add(rec);
+        if (i == 999) {
+            dbfile.MoveFirst();
+        }
+    }
+    ASSERT_EQ(1, dbfile.GetNumIndexes());
+
+    // the records of the scan hold the key only
+    Attribute keyAtt = {(char *) "key", Int};
+    Schema keySchema((char *) "projkey", 1, &keyAtt);
+    Operand left = {NAME, (char *) "key"};
+    Operand right = {INT, (char *) "100"};
+    ComparisonOp comparison = {LESS_THAN, &left, &right};
+    OrList orList = {&comparison, NULL};
+    AndList andList = {&orList, NULL};
+    CNF cnf;
+    Record literal;
+    cnf.GrowFromParseTree(&andList, &keySchema, literal);
+    dbfile.MoveFirst();
+    Record rec;
+    int expected = 0;
+    while (dbfile.GetNextFromIndex(0, rec, cnf, literal)) {
+        ASSERT_EQ(2 * sizeof(int), ((int *) rec.bits)[1]);
+        ASSERT_EQ(expected, *((int *) (rec.bits + ((int *) rec.bits)[1])));
+        expected++;
+    }
+    ASSERT_EQ(100, expected);
+    dbfile.Close();
+    system("rm -f projtest.*");
+}
+
+TEST(BatchTesting, addBatchKeepsRecordOrder) {
+    KeyPadTable table("batchtest", 200);
+    const int numRecords = 3000;
+    Record * batch = new Record[numRecords];
+
+    // single adds, a batch spanning several pages and a whole page, in that order
+    DBFile dbfile;
+    ASSERT_EQ(1, table.Create(dbfile, heap));
+    table.Fill(dbfile, 10, 10, 1);
+    int key = 10;
+    for (int i = 0; i < numRecords; i++, key++) {
+        table.Compose(batch[i], key);
+    }
+    dbfile.AddBatch(batch, numRecords);
+    Page page;
+    for (int i = 0; i < 100; i++, key++) {
+        Record rec;
+        table.Compose(rec, key);
+        ASSERT_EQ(1, page.Append(&rec));
+    }
+    dbfile.AddBatch(page);
+    ASSERT_EQ(0, page.getNumRecs());
+    dbfile.Close();
+    ASSERT_EQ(1, table.Open(dbfile));
+    dbfile.MoveFirst();
+    Record rec;
+    int expected = 0;
+    while (dbfile.GetNext(rec)) {
+        ASSERT_EQ(expected, *((int *) (rec.bits + ((int *) rec.bits)[1])));
+        expected++;
+    }
+    ASSERT_EQ(key, expected);
+    dbfile.Close();
+
+    // a sorted file hands the batch to its sorter
+    table.Remove();
+    ASSERT_EQ(1, table.Create(dbfile, sorted));
+    for (int i = 0; i < numRecords; i++) {
+        table.Compose(batch[i], numRecords - 1 - i);
+    }
+    dbfile.AddBatch(batch, numRecords);
+    dbfile.MoveFirst();
+    expected = 0;
+    while (dbfile.GetNext(rec)) {
+        ASSERT_EQ(expected, *((int *) (rec.bits + ((int *) rec.bits)[1])));
+        expected++;
+    }
+    ASSERT_EQ(numRecords, expected);
+    dbfile.Close();
+    delete [] batch;
+}
+
+TEST(ScanTesting, getNextPageReadsEveryRecord) {
+    KeyPadTable table("pagetest", 200);
+    const int numRecords = 3000;
+
+    // a heap file hands over its pages, a sorted file with a segment fills them from the merge
+    fType types[2] = {heap, sorted};
+    for (int t = 0; t < 2; t++) {
+        DBFile dbfile;
+        ASSERT_EQ(1, table.Create(dbfile, types[t]));
+        table.Fill(dbfile, numRecords, numRecords, 1, numRecords / 2 + 1);
+        dbfile.MoveFirst();
+
+        // the rest of a page partly read by GetNext comes first
+        Record rec;
+        int expected = 0;
+        for (; expected < 5; expected++) {
+            ASSERT_EQ(1, dbfile.GetNext(rec));
+        }
+        Page page;
+        std::vector<Record *> records;
+        while (dbfile.GetNextPage(page)) {
+            page.GetRecords(records);
+            ASSERT_EQ(page.getNumRecs(), records.size());
+            for (int i = 0; i < records.size(); i++) {
+                ASSERT_EQ(expected, *((int *) (records[i]->bits + ((int *) records[i]->bits)[1])));
+                expected++;
+            }
+        }
+        ASSERT_EQ(numRecords, expected);
+        dbfile.Close();
+        table.Remove();
+    }
+}
+
+static void *ScanWithCursor(void *arg) {
+    Cursor *cursor = (Cursor *) arg;
+    Record rec;
+    long sum = 0;
+    while (cursor->GetNext(rec)) {
+        sum += *((int *) (rec.bits + ((int *) rec.bits)[1]));
+    }
+    return (void *) sum;
+}
+
+TEST(ScanTesting, cursorsScanIndependently) {
+    KeyPadTable table("cursortest", 200);
+    const int numRecords = 3000;
+    const int numThreads = 4;
+
+    // the heap file is filled in key order, the sorted file out of it
+    fType types[2] = {heap, sorted};
+    for (int t = 0; t < 2; t++) {
+        DBFile dbfile;
+        ASSERT_EQ(1, table.Create(dbfile, types[t]));
+        table.Fill(dbfile, numRecords, numRecords, types[t] == sorted ? 7919 : 1, numRecords / 2 + 1);
+
+        // two cursors read in turns without moving each other
+        Cursor *first = dbfile.OpenCursor();
+        Cursor *second = dbfile.OpenCursor();
+        ASSERT_TRUE(first != NULL && second != NULL);
+        Record rec;
+        for (int i = 0; i < numRecords; i++) {
+            ASSERT_EQ(1, first->GetNext(rec));
+            ASSERT_EQ(i, *((int *) (rec.bits + ((int *) rec.bits)[1])));
+            if (i % 2 == 0) {
+                ASSERT_EQ(1, second->GetNext(rec));
+                ASSERT_EQ(i / 2, *((int *) (rec.bits + ((int *) rec.bits)[1])));
+            }
+        }
+        ASSERT_EQ(0, first->GetNext(rec));
+        first->MoveFirst();
+        ASSERT_EQ(1, first->GetNext(rec));
+        ASSERT_EQ(0, *((int *) (rec.bits + ((int *) rec.bits)[1])));
+        delete first;
+        delete second;
+
+        // and each thread scans the whole file with a cursor of its own
+        pthread_t threads[numThreads];
+        Cursor *cursors[numThreads];
+        for (int i = 0; i < numThreads; i++) {
+            cursors[i] = dbfile.OpenCursor();
+            pthread_create(&threads[i], NULL, ScanWithCursor, cursors[i]);
+        }
+        for (int i = 0; i < numThreads; i++) {
+            void *sum;
+            pthread_join(threads[i], &sum);
+            ASSERT_EQ((long) numRecords * (numRecords - 1) / 2, (long) sum);
+            delete cursors[i];
+        }
+        dbfile.Close();
+        table.Remove();
+    }
+}
+
+TEST(ScanTesting, parallelScanFiltersEveryMorsel) {
+    KeyPadTable table("morseltest", 500);
+    const int numRecords = 6000;
+
+    Operand left = {NAME, (char *) "key"};
+    Operand right = {INT, (char *) "1000"};
+    ComparisonOp comparison = {LESS_THAN, &left, &right};
+    OrList orList = {&comparison, NULL};
+    AndList andList = {&orList, NULL};
+    CNF cnf;
+    Record literal;
+    cnf.GrowFromParseTree(&andList, &table.schema, literal);
+
+    // a heap file is split into morsels, a sorted file is scanned by one worker
+    fType types[2] = {heap, sorted};
+    for (int t = 0; t < 2; t++) {
+        DBFile dbfile;
+        ASSERT_EQ(1, table.Create(dbfile, types[t]));
+        table.Fill(dbfile, numRecords, numRecords);
+        Pipe out(100);
+        ParallelScan scan(dbfile, out, cnf, literal, 4);
+        Record rec;
+        long sum = 0;
+        int matches = 0;
+        while (out.Remove(&rec)) {
+            int key = *((int *) (rec.bits + ((int *) rec.bits)[1]));
+            ASSERT_LT(key, 1000);
+            sum += key;
+            matches++;
+        }
+        scan.WaitUntilDone();
+        ASSERT_EQ(1000, matches);
+        ASSERT_EQ(999 * 1000 / 2, sum);
+        dbfile.Close();
+        table.Remove();
+    }
+}
+
+TEST(RelOpTesting, selectFileStreamsMatches) {
+    KeyPadTable table("selecttest", 500);
+    const int numRecords = 6000;
+
+    Operand left = {NAME, (char *) "key"};
+    Operand right = {INT, (char *) "1234"};
+    ComparisonOp comparison = {EQUALS, &left, &right};
+    OrList orList = {&comparison, NULL};
+    AndList andList = {&orList, NULL};
+    CNF cnf;
+    Record literal;
+    cnf.GrowFromParseTree(&andList, &table.schema, literal);
+
+    // a heap file is read page by page, a sorted file is searched on the CNF
+    fType types[2] = {heap, sorted};
+    for (int t = 0; t < 2; t++) {
+        DBFile dbfile;
+        ASSERT_EQ(1, table.Create(dbfile, types[t]));
+        table.Fill(dbfile, numRecords, 2000);
+        dbfile.MoveFirst();
+        Pipe out(100);
+        SelectFile select;
+        select.Use_n_Pages(4);
+        select.Run(dbfile, out, cnf, literal);
+        Record rec;
+        int matches = 0;
+        while (out.Remove(&rec)) {
+            ASSERT_EQ(1234, *((int *) (rec.bits + ((int *) rec.bits)[1])));
+            matches++;
+        }
+        select.WaitUntilDone();
+        ASSERT_EQ(3, matches);
+        dbfile.Close();
+        table.Remove();
+    }
+}
+
+TEST(RelOpTesting, joinMergesDuplicateKeys) {
+    Attribute leftAtts[2] = {{(char *) "l_key", Int}, {(char *) "l_pad", String}};
+    Attribute rightAtts[2] = {{(char *) "r_key", Int}, {(char *) "r_pad", String}};
+    Schema leftSchema((char *) "jleft", 2, leftAtts);
+    Schema rightSchema((char *) "jright", 2, rightAtts);
+    system("rm -f jleft.* jright.*");
+
+    // every right key has 500 records of 1 KB, more than the group keeps in memory
+    DBFile leftFile, rightFile;
+    ASSERT_EQ(1, leftFile.Create("jleft.bin", heap, NULL));
+    ASSERT_EQ(1, rightFile.Create("jright.bin", heap, NULL));
+    for (int i = 0; i < 3000; i++) {
+        std::string text = std::to_string(i % 500) + "|l|";
+        Record rec;
+        rec.ComposeRecord(&leftSchema, text.c_str());
+        leftFile.Add(rec);
+    }
+    std::string pad(1000, 'r');
+    for (int i = 0; i < 1000; i++) {
+        std::string text = std::to_string(i % 2) + "|" + pad + "|";
+        Record rec;
+        rec.ComposeRecord(&rightSchema, text.c_str());
+        rightFile.Add(rec);
+    }
+    leftFile.MoveFirst();
+    rightFile.MoveFirst();
+
+    Operand left = {NAME, (char *) "l_key"};
+    Operand right = {NAME, (char *) "r_key"};
+    ComparisonOp comparison = {EQUALS, &left, &right};
+    OrList orList = {&comparison, NULL};
+    AndList andList = {&orList, NULL};
+    CNF cnf, all;
+    Record literal, noLiteral;
+    cnf.GrowFromParseTree(&andList, &leftSchema, &rightSchema, literal);
+    all.GrowFromParseTree(NULL, &leftSchema, noLiteral);
+
+    Pipe leftPipe(100), rightPipe(100), out(100);
+    SelectFile scanLeft, scanRight;
+    Join join;
+    join.Use_n_Pages(2);
+    scanLeft.Run(leftFile, leftPipe, all, noLiteral);
+    scanRight.Run(rightFile, rightPipe, all, noLiteral);
+    join.Run(leftPipe, rightPipe, out, cnf, literal);
+
+    Record rec;
+    int matches = 0;
+    while (out.Remove(&rec)) {
+        int *bits = (int *) rec.bits;
+        ASSERT_EQ(*((int *) (rec.bits + bits[1])), *((int *) (rec.bits + bits[3])));
+        matches++;
+    }
+    scanLeft.WaitUntilDone();
+    scanRight.WaitUntilDone();
+    join.WaitUntilDone();
+    ASSERT_EQ(6000, matches);
+    leftFile.Close();
+    rightFile.Close();
+    system("rm -f jleft.* jright.*");
+}
+
+TEST(RelOpTesting, mergeJoinSplitsGovernorShare) {
+    Attribute leftAtts[2] = {{(char *) "l_key", Int}, {(char *) "l_pad", String}};
+    Attribute rightAtts[2] = {{(char *) "r_key", Int}, {(char *) "r_pad", String}};
+    Schema leftSchema((char *) "gleft", 2, leftAtts);
+    Schema rightSchema((char *) "gright", 2, rightAtts);
+    system("rm -f gleft.* gright.*");
+
+    // both inputs span several runs of the three pages each sort plans with
+    DBFile leftFile, rightFile;
+    ASSERT_EQ(1, leftFile.Create("gleft.bin", heap, NULL));
+    ASSERT_EQ(1, rightFile.Create("gright.bin", heap, NULL));
+    std::string pad(1000, 'g');
+    for (int i = 0; i < 2000; i++) {
+        std::string text = std::to_string((i * 7919) % 1000) + "|" + pad + "|";
+        Record rec;
+        rec.ComposeRecord(&leftSchema, text.c_str());
+        leftFile.Add(rec);
+        rec.ComposeRecord(&rightSchema, text.c_str());
+        rightFile.Add(rec);
+    }
+    leftFile.MoveFirst();
+    rightFile.MoveFirst();
+
+    Operand left = {NAME, (char *) "l_key"};
+    Operand right = {NAME, (char *) "r_key"};
+    ComparisonOp comparison = {EQUALS, &left, &right};
+    OrList orList = {&comparison, NULL};
+    AndList andList = {&orList, NULL};
+    CNF cnf, all;
+    Record literal, noLiteral;
+    cnf.GrowFromParseTree(&andList, &leftSchema, &rightSchema, literal);
+    all.GrowFromParseTree(NULL, &leftSchema, noLiteral);
+
+    MemoryGovernor governor(7 * PAGE_SIZE);
+    Pipe leftPipe(100), rightPipe(100), out(100);
+    SelectFile scanLeft, scanRight;
+    Join join;
+    join.Use_n_Pages(2);
+    join.Use_Memory_Governor(&governor, governor.Register(1));
+    scanLeft.Run(leftFile, leftPipe, all, noLiteral);
+    scanRight.Run(rightFile, rightPipe, all, noLiteral);
+    join.Run(leftPipe, rightPipe, out, cnf, literal);
+
+    Record rec;
+    int matches = 0;
+    while (out.Remove(&rec)) {
+        int *bits = (int *) rec.bits;
+        ASSERT_EQ(*((int *) (rec.bits + bits[1])), *((int *) (rec.bits + bits[3])));
+        matches++;
+    }
+    scanLeft.WaitUntilDone();
+    scanRight.WaitUntilDone();
+    join.WaitUntilDone();
+    ASSERT_EQ(4000, matches);
+    // neither sort takes the whole share, so none falls back to its minimum
+    ASSERT_LE(governor.GetPeakUsage(), 7 * PAGE_SIZE);
+    ASSERT_EQ(0, governor.GetUsage());
+    leftFile.Close();
+    rightFile.Close();
+    system("rm -f gleft.* gright.*");
+}
+
+TEST(RelOpTesting, joinMethodsMatchDuplicateKeys) {
+    Attribute leftAtts[2] = {{(char *) "l_key", Int}, {(char *) "l_pad", String}};
+    Attribute rightAtts[2] = {{(char *) "r_key", Int}, {(char *) "r_pad", String}};
+    Schema leftSchema((char *) "hleft", 2, leftAtts);
+    Schema rightSchema((char *) "hright", 2, rightAtts);
+    system("rm -f hleft.* hright.*");
+
+    // every right key has 50 records of 3 KB, more than one page of memory holds
+    DBFile leftFile, rightFile;
+    ASSERT_EQ(1, leftFile.Create("hleft.bin", heap, NULL));
+    ASSERT_EQ(1, rightFile.Create("hright.bin", heap, NULL));
+    for (int i = 0; i < 3000; i++) {
+        std::string text = std::to_string(i % 500) + "|l|";
+        Record rec;
+        rec.ComposeRecord(&leftSchema, text.c_str());
+        leftFile.Add(rec);
+    }
+    std::string pad(3000, 'r');
+    for (int i = 0; i < 1000; i++) {
+        std::string text = std::to_string(i % 20) + "|" + pad + "|";
+        Record rec;
+        rec.ComposeRecord(&rightSchema, text.c_str());
+        rightFile.Add(rec);
+    }
+
+    Operand left = {NAME, (char *) "l_key"};
+    Operand right = {NAME, (char *) "r_key"};
+    ComparisonOp comparison = {EQUALS, &left, &right};
+    OrList orList = {&comparison, NULL};
+    AndList andList = {&orList, NULL};
+    CNF cnf, all;
+    Record literal, noLiteral;
+    cnf.GrowFromParseTree(&andList, &leftSchema, &rightSchema, literal);
+    all.GrowFromParseTree(NULL, &leftSchema, noLiteral);
+
+    // hybrid and radix hash building on either side, nested loops
+    JoinMethod methods[5] = {HybridHash, HybridHash, RadixHash, RadixHash, BlockNestedLoop};
+    int buildLeft[5] = {1, 0, 1, 0, 0};
+    for (int m = 0; m < 5; m++) {
+        leftFile.MoveFirst();
+        rightFile.MoveFirst();
+        Pipe leftPipe(100), rightPipe(100), out(100);
+        SelectFile scanLeft, scanRight;
+        Join join;
+        join.Use_n_Pages(1);
+        join.Use_Method(methods[m], buildLeft[m]);
+        scanLeft.Run(leftFile, leftPipe, all, noLiteral);
+        scanRight.Run(rightFile, rightPipe, all, noLiteral);
+        join.Run(leftPipe, rightPipe, out, cnf, literal);
+
+        Record rec;
+        int matches = 0;
+        while (out.Remove(&rec)) {
+            int *bits = (int *) rec.bits;
+            ASSERT_EQ(*((int *) (rec.bits + bits[1])), *((int *) (rec.bits + bits[3])));
+            matches++;
+        }
+        scanLeft.WaitUntilDone();
+        scanRight.WaitUntilDone();
+        join.WaitUntilDone();
+        ASSERT_EQ(6000, matches);
+    }
+    leftFile.Close();
+    rightFile.Close();
+    system("rm -f hleft.* hright.*");
+}
+
+TEST(RelOpTesting, radixTableFindsEveryKey) {
+    // two partitioning passes put every entry in the partition of its low bits
+    vector<RadixEntry> entries(100000);
+    for (int i = 0; i < entries.size(); i++) {
+        entries[i].hash = (unsigned long) i * 2654435761UL;
+        entries[i].rec = NULL;
+    }
+    vector<int> starts;
+    RadixHashTable::Partition(entries, 12, starts);
+    ASSERT_EQ(100000, starts[1 << 12]);
+    for (int p = 0; p < (1 << 12); p++) {
+        for (int i = starts[p]; i < starts[p + 1]; i++) {
+            ASSERT_EQ(p, entries[i].hash & ((1 << 12) - 1));
+        }
+    }
+
+    Attribute atts[1] = {{(char *) "key", Int}};
+    Schema schema((char *) "radixtest", 1, atts);
+    OrderMaker order(&schema);
+    RadixHashTable table;
+    for (int i = 0; i < 50000; i++) {
+        std::string text = std::to_string(i % 25000) + "|";
+        Record *rec = new Record();
+        rec->ComposeRecord(&schema, text.c_str());
+        table.Add(order.Hash(rec), rec);
+    }
+    table.Build(2);
+    ASSERT_LT(0, table.GetBits());
+    for (int i = 0; i < 25000; i++) {
+        std::string text = std::to_string(i) + "|";
+        Record probe;
+        probe.ComposeRecord(&schema, text.c_str());
+        unsigned long hash = order.Hash(&probe);
+        int found = 0;
+        for (int entry = table.GetFirst(hash); entry >= 0; entry = table.GetNext(entry, hash)) {
+            ASSERT_EQ(i, *((int *) (table.GetRecord(entry)->bits + 8)));
+            found++;
+        }
+        ASSERT_EQ(2, found);
+    }
+}
+
+TEST(RelOpTesting, nestedLoopJoinMatchesInequality) {
+    Attribute leftAtts[2] = {{(char *) "l_key", Int}, {(char *) "l_pad", String}};
+    Attribute rightAtts[1] = {{(char *) "r_key", Int}};
+    Schema leftSchema((char *) "nleft", 2, leftAtts);
+    Schema rightSchema((char *) "nright", 1, rightAtts);
+
+    Operand left = {NAME, (char *) "l_key"};
+    Operand right = {NAME, (char *) "r_key"};
+    ComparisonOp comparison = {LESS_THAN, &left, &right};
+    OrList orList = {&comparison, NULL};
+    AndList andList = {&orList, NULL};
+    CNF cnf;
+    Record literal;
+    cnf.GrowFromParseTree(&andList, &leftSchema, &rightSchema, literal);
+
+    // 1 KB left records fill about three blocks of one page
+    Pipe leftPipe(400), rightPipe(400), out(100);
+    std::string pad(1000, 'l');
+    for (int i = 0; i < 300; i++) {
+        std::string text = std::to_string(i) + "|" + pad + "|";
+        Record rec;
+        rec.ComposeRecord(&leftSchema, text.c_str());
+        leftPipe.Insert(&rec);
+    }
+    for (int i = 0; i < 200; i++) {
+        std::string text = std::to_string(i) + "|";
+        Record rec;
+        rec.ComposeRecord(&rightSchema, text.c_str());
+        rightPipe.Insert(&rec);
+    }
+    leftPipe.ShutDown();
+    rightPipe.ShutDown();
+
+    Join join;
+    join.Use_n_Pages(2);
+    join.Run(leftPipe, rightPipe, out, cnf, literal);
+    Record rec;
+    int matches = 0;
+    while (out.Remove(&rec)) {
+        int *bits = (int *) rec.bits;
+        ASSERT_LT(*((int *) (rec.bits + bits[1])), *((int *) (rec.bits + bits[3])));
+        matches++;
+    }
+    join.WaitUntilDone();
+    ASSERT_EQ(199 * 200 / 2, matches);
+}
+
+TEST(RelOpTesting, indexJoinProbesSortedAndIndexedFiles) {
+    Attribute leftAtts[2] = {{(char *) "l_key", Int}, {(char *) "l_pad", String}};
+    Attribute rightAtts[2] = {{(char *) "r_key", Int}, {(char *) "r_val", Int}};
+    Schema leftSchema((char *) "ileft", 2, leftAtts);
+    Schema rightSchema((char *) "iright", 2, rightAtts);
+    OrderMaker order;
+    order.numAtts = 1;
+    order.whichAtts[0] = 0;
+    order.whichTypes[0] = Int;
+    SortedStartUp startup = {&order, 2, tiered};
+    system("rm -f iright.*");
+
+    Operand left = {NAME, (char *) "l_key"};
+    Operand right = {NAME, (char *) "r_key"};
+    ComparisonOp comparison = {EQUALS, &left, &right};
+    OrList orList = {&comparison, NULL};
+    AndList andList = {&orList, NULL};
+    CNF cnf, all;
+    Record literal, noLiteral;
+    cnf.GrowFromParseTree(&andList, &leftSchema, &rightSchema, literal);
+    all.GrowFromParseTree(NULL, &rightSchema, noLiteral);
+    std::string pad(1000, 'l');
+
+    // a sorted file is searched, a heap file is probed through its index
+    fType types[2] = {sorted, heap};
+    for (int t = 0; t < 2; t++) {
+        DBFile rightFile;
+        ASSERT_EQ(1, rightFile.Create("iright.bin", types[t], types[t] == sorted ? &startup : NULL));
+        if (types[t] == heap) {
+            ASSERT_EQ(1, rightFile.CreateIndex(order));
+        }
+        for (int i = 0; i < 5000; i++) {
+            std::string text = std::to_string((i * 7) % 1000) + "|" + std::to_string(i) + "|";
+            Record rec;
+            rec.ComposeRecord(&rightSchema, text.c_str());
+            rightFile.Add(rec);
+        }
+        rightFile.MoveFirst();
+
+        // every left key is there twice, in blocks of one page
+        Pipe leftPipe(500), out(100);
+        for (int i = 0; i < 400; i++) {
+            std::string text = std::to_string((i * 3) % 200) + "|" + pad + "|";
+            Record rec;
+            rec.ComposeRecord(&leftSchema, text.c_str());
+            leftPipe.Insert(&rec);
+        }
+        leftPipe.ShutDown();
+
+        Join join;
+        join.Use_n_Pages(1);
+        join.Run(leftPipe, rightFile, all, noLiteral, out, cnf, literal);
+        Record rec;
+        int matches = 0;
+        while (out.Remove(&rec)) {
+            int *bits = (int *) rec.bits;
+            ASSERT_EQ(*((int *) (rec.bits + bits[1])), *((int *) (rec.bits + bits[3])));
+            matches++;
+        }
+        join.WaitUntilDone();
+        ASSERT_EQ(400 * 5, matches);
+        rightFile.Close();
+        system("rm -f iright.*");
+    }
+}
+
+TEST(RelOpTesting, mergeJoinTakesSortedFilesAsTheyAre) {
+    Attribute leftAtts[2] = {{(char *) "l_key", Int}, {(char *) "l_val", Int}};
+    Attribute rightAtts[2] = {{(char *) "r_val", Int}, {(char *) "r_key", Int}};
+    Schema leftSchema((char *) "mleft", 2, leftAtts);
+    Schema rightSchema((char *) "mright", 2, rightAtts);
+    OrderMaker leftSort, rightSort;
+    leftSort.numAtts = 2;
+    leftSort.whichAtts[0] = 0;
+    leftSort.whichTypes[0] = Int;
+    leftSort.whichAtts[1] = 1;
+    leftSort.whichTypes[1] = Int;
+    rightSort.numAtts = 1;
+    rightSort.whichAtts[0] = 1;
+    rightSort.whichTypes[0] = Int;
+    SortedStartUp leftStartup = {&leftSort, 2, tiered};
+    SortedStartUp rightStartup = {&rightSort, 2, tiered};
+    system("rm -f mleft.* mright.*");
+
+    DBFile leftFile, rightFile;
+    ASSERT_EQ(1, leftFile.Create("mleft.bin", sorted, &leftStartup));
+    ASSERT_EQ(1, rightFile.Create("mright.bin", sorted, &rightStartup));
+    for (int i = 0; i < 2000; i++) {
+        std::string text = std::to_string((i * 7) % 500) + "|" + std::to_string(i) + "|";
+        Record rec;
+        rec.ComposeRecord(&leftSchema, text.c_str());
+        leftFile.Add(rec);
+    }
+    for (int i = 0; i < 1000; i++) {
+        std::string text = std::to_string(i) + "|" + std::to_string((i * 3) % 250) + "|";
+        Record rec;
+        rec.ComposeRecord(&rightSchema, text.c_str());
+        rightFile.Add(rec);
+    }
+    leftFile.MoveFirst();
+    rightFile.MoveFirst();
+
+    Operand left = {NAME, (char *) "l_key"};
+    Operand right = {NAME, (char *) "r_key"};
+    ComparisonOp comparison = {EQUALS, &left, &right};
+    OrList orList = {&comparison, NULL};
+    AndList andList = {&orList, NULL};
+    CNF cnf, all;
+    Record literal, noLiteral;
+    cnf.GrowFromParseTree(&andList, &leftSchema, &rightSchema, literal);
+    all.GrowFromParseTree(NULL, &leftSchema, noLiteral);
+
+    // both files are in the join order, so neither needs a sort
+    OrderMaker leftOrder, rightOrder, orderL, orderR;
+    ASSERT_EQ(1, leftFile.GetSortOrder(leftOrder));
+    ASSERT_EQ(1, rightFile.GetSortOrder(rightOrder));
+    ASSERT_NE(0, cnf.GetSortOrders(orderL, orderR));
+    int sortedL, sortedR;
+    Join::AlignInputOrders(leftOrder, rightOrder, orderL, orderR, sortedL, sortedR);
+    ASSERT_EQ(1, sortedL);
+    ASSERT_EQ(1, sortedR);
+
+    Pipe leftPipe(100), rightPipe(100), out(100);
+    SelectFile scanLeft, scanRight;
+    Join join;
+    join.Use_n_Pages(1);
+    join.Use_Method(SortMerge, 0);
+    join.Use_Input_Orders(leftOrder, rightOrder);
+    scanLeft.Run(leftFile, leftPipe, all, noLiteral);
+    scanRight.Run(rightFile, rightPipe, all, noLiteral);
+    join.Run(leftPipe, rightPipe, out, cnf, literal);
+
+    // the keys come out in order
+    Record rec;
+    int matches = 0, lastKey = -1;
+    while (out.Remove(&rec)) {
+        int *bits = (int *) rec.bits;
+        int key = *((int *) (rec.bits + bits[1]));
+        ASSERT_EQ(key, *((int *) (rec.bits + bits[4])));
+        ASSERT_LE(lastKey, key);
+        lastKey = key;
+        matches++;
+    }
+    scanLeft.WaitUntilDone();
+    scanRight.WaitUntilDone();
+    join.WaitUntilDone();
+    ASSERT_EQ(1000 * 4, matches);
+    leftFile.Close();
+    rightFile.Close();
+    system("rm -f mleft.* mright.*");
+}
+
+TEST(RelOpTesting, joinFilterDropsUnmatchedProbeRecords) {
+    Attribute leftAtts[2] = {{(char *) "l_key", Int}, {(char *) "l_val", Int}};
+    Attribute rightAtts[2] = {{(char *) "r_key", Int}, {(char *) "r_val", Int}};
+    Schema leftSchema((char *) "fleft", 2, leftAtts);
+    Schema rightSchema((char *) "fright", 2, rightAtts);
+    system("rm -f fright.*");
+
+    // two probe records for every one of the 100 build keys, out of 10000
+    DBFile rightFile;
+    ASSERT_EQ(1, rightFile.Create("fright.bin", heap, NULL));
+    for (int i = 0; i < 10000; i++) {
+        std::string text = std::to_string((i * 7) % 5000) + "|" + std::to_string(i) + "|";
+        Record rec;
+        rec.ComposeRecord(&rightSchema, text.c_str());
+        rightFile.Add(rec);
+    }
+
+    Operand left = {NAME, (char *) "l_key"};
+    Operand right = {NAME, (char *) "r_key"};
+    ComparisonOp comparison = {EQUALS, &left, &right};
+    OrList orList = {&comparison, NULL};
+    AndList andList = {&orList, NULL};
+    CNF cnf, all;
+    Record literal, noLiteral;
+    cnf.GrowFromParseTree(&andList, &leftSchema, &rightSchema, literal);
+    all.GrowFromParseTree(NULL, &rightSchema, noLiteral);
+
+    // hybrid and radix hash joins build on the left, so does sort-merge
+    JoinMethod methods[3] = {HybridHash, RadixHash, SortMerge};
+    for (int m = 0; m < 3; m++) {
+        rightFile.MoveFirst();
+        Pipe leftPipe(200), rightPipe(100), out(100);
+        for (int i = 0; i < 100; i++) {
+            std::string text = std::to_string(i * 50) + "|" + std::to_string(i) + "|";
+            Record rec;
+            rec.ComposeRecord(&leftSchema, text.c_str());
+            leftPipe.Insert(&rec);
+        }
+        leftPipe.ShutDown();
+
+        JoinFilter filter;
+        SelectFile scan;
+        Join join;
+        scan.Use_Filter(filter);
+        join.Use_n_Pages(10);
+        join.Use_Method(methods[m], 1);
+        join.Use_Filter(filter);
+        scan.Run(rightFile, rightPipe, all, noLiteral);
+        join.Run(leftPipe, rightPipe, out, cnf, literal);
+
+        Record rec;
+        int matches = 0;
+        while (out.Remove(&rec)) {
+            int *bits = (int *) rec.bits;
+            ASSERT_EQ(*((int *) (rec.bits + bits[1])), *((int *) (rec.bits + bits[3])));
+            matches++;
+        }
+        scan.WaitUntilDone();
+        join.WaitUntilDone();
+        ASSERT_EQ(200, matches);
+        ASSERT_EQ(10000, filter.GetProbed());
+        ASSERT_GE(filter.GetDropped(), 9800 * 0.95);
+        ASSERT_LE(filter.GetDropped(), 9800);
+    }
+    rightFile.Close();
+    system("rm -f fright.*");
+}
+
 int main(int argc, char **argv) {
     testing::InitGoogleTest(&argc, argv);
     return RUN_ALL_TESTS();
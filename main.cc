@@ -23,6 +23,8 @@ extern struct NameList *groupingAtts; 		// grouping atts (NULL if no grouping)
 extern struct NameList *attsToSelect; 		// the set of attributes in the SELECT (NULL if no such atts)
 extern int distinctAtts; 					// 1 if there is a DISTINCT in a non-aggregate query 
 extern int distinctFunc;  					// 1 if there is a DISTINCT in an aggregate query
+extern struct NameList *orderingAtts; 		// ordering atts (NULL if no ORDER BY)
+extern int limitCount; 						// number of rows to return (0 if no LIMIT)
 
 
 
@@ -66,6 +68,14 @@ int main () {
 	
 	sort (tableNames.begin (), tableNames.end ());
 	
+	// every attribute the query reads, to find the scans an index can answer alone
+	vector<string> queryAtts;
+	CopyCNFNames (boolean, queryAtts);
+	CopyFunctionNames (finalFunction, queryAtts);
+	CopyNameList (attsToSelect, queryAtts);
+	CopyNameList (groupingAtts, queryAtts);
+	CopyNameList (orderingAtts, queryAtts);
+	
 	int minCost = INT_MAX, cost = 0;
 	int counter = 1;
 	
@@ -105,16 +115,23 @@ int main () {
 	
 	QueryNode *root;
 	
+	// replay the chosen join order to estimate the tuples out of every node
+	Statistics planStats (s);
+	MemoryGovernor governor (queryMemoryBudget);
+	vector<QueryNode *> memoryConsumers;
+	buffer[0] = joinOrder[0];
+	
 	auto iter = joinOrder.begin ();
 	SelectFileNode *selectFileNode = new SelectFileNode ();
 	
 	char filepath[50];
-	selectFileNode->opened = true;
 	selectFileNode->pid = getPid ();
 	selectFileNode->sch = Schema (schemaMap[aliaseMap[*iter]]);
 	selectFileNode->sch.Reset (*iter);
+	PlanSelectFile (selectFileNode, aliaseMap[*iter], queryAtts);
 	
 	selectFileNode->cnf.GrowFromParseTree (boolean, &(selectFileNode->sch), selectFileNode->literal);
+	selectFileNode->estimate = (*planStats.GetStatsMap ())[*iter]->GetNofTuples ();
 	
 	iter++;
 	if (iter == joinOrder.end ()) {
@@ -129,16 +146,23 @@ int main () {
 		joinNode->left = selectFileNode;
 		
 		selectFileNode = new SelectFileNode ();
-		selectFileNode->opened = true;
 		selectFileNode->pid = getPid ();
 		selectFileNode->sch = Schema (schemaMap[aliaseMap[*iter]]);
 		selectFileNode->sch.Reset (*iter);
+		PlanSelectFile (selectFileNode, aliaseMap[*iter], queryAtts);
 		selectFileNode->cnf.GrowFromParseTree (boolean, &(selectFileNode->sch), selectFileNode->literal);
+		selectFileNode->estimate = (*planStats.GetStatsMap ())[*iter]->GetNofTuples ();
 		
 		joinNode->right = selectFileNode;
 		joinNode->sch.JoinSchema (joinNode->left->sch, joinNode->right->sch);
 		joinNode->cnf.GrowFromParseTree (boolean, &(joinNode->left->sch), &(joinNode->right->sch), joinNode->literal);
 		
+		buffer[1] = *iter;
+		joinNode->estimate = planStats.Estimate (boolean, &buffer[0], 2);
+		planStats.Apply (boolean, &buffer[0], 2);
+		PlanJoin (joinNode);
+		RegisterMemory (joinNode, joinNode->left->estimate + joinNode->right->estimate, governor, memoryConsumers);
+		
 		iter++;
 		
 		while (iter != joinOrder.end ()) {
@@ -146,11 +170,12 @@ int main () {
 			JoinNode *p = joinNode;
 			
 			selectFileNode = new SelectFileNode ();
-			selectFileNode->opened = true;
 			selectFileNode->pid = getPid ();
 			selectFileNode->sch = Schema (schemaMap[aliaseMap[*iter]]);
 			selectFileNode->sch.Reset (*iter);
+			PlanSelectFile (selectFileNode, aliaseMap[*iter], queryAtts);
 			selectFileNode->cnf.GrowFromParseTree (boolean, &(selectFileNode->sch), selectFileNode->literal);
+			selectFileNode->estimate = (*planStats.GetStatsMap ())[*iter]->GetNofTuples ();
 			
 			joinNode = new JoinNode ();
 			joinNode->pid = getPid ();
@@ -159,6 +184,12 @@ int main () {
 			joinNode->sch.JoinSchema (joinNode->left->sch, joinNode->right->sch);
 			joinNode->cnf.GrowFromParseTree (boolean, &(joinNode->left->sch), &(joinNode->right->sch), joinNode->literal);
 			
+			buffer[1] = *iter;
+			joinNode->estimate = planStats.Estimate (boolean, &buffer[0], 2);
+			planStats.Apply (boolean, &buffer[0], 2);
+			PlanJoin (joinNode);
+			RegisterMemory (joinNode, joinNode->left->estimate + joinNode->right->estimate, governor, memoryConsumers);
+			
 			iter++;
 		}
 		root = joinNode;
@@ -172,7 +203,9 @@ int main () {
 			root = new DistinctNode ();
 			root->pid = getPid ();
 			root->sch = temp->sch;
+			root->estimate = temp->estimate;
 			((DistinctNode *) root)->from = temp;
+			RegisterMemory (root, temp->estimate, governor, memoryConsumers);
 			temp = root;
 		}
 		
@@ -186,6 +219,8 @@ int main () {
 		root->sch.GroupBySchema (temp->sch, ((GroupByNode *) root)->compute.ReturnInt ());
 		((GroupByNode *) root)->group.growFromParseTree (groupingAtts, &(root->sch));
 		((GroupByNode *) root)->from = temp;
+		root->estimate = temp->estimate;
+		RegisterMemory (root, temp->estimate, governor, memoryConsumers);
 		
 	} 
 	else if (finalFunction) {
@@ -199,9 +234,36 @@ int main () {
 		root->sch = Schema (NULL, 1, ((SumNode *) root)->compute.ReturnInt () ? atts[0] : atts[1]);
 		
 		((SumNode *) root)->from = temp;
+		root->estimate = 1;
 		
 	}
     temp= root;
+    if (orderingAtts) {
+		
+		root = new OrderByNode ();
+		
+		root->pid = getPid ();
+		root->sch = temp->sch;
+		((OrderByNode *) root)->order.growFromParseTree (orderingAtts, &(root->sch));
+		((OrderByNode *) root)->limit = limitCount;
+		((OrderByNode *) root)->from = temp;
+		root->estimate = limitCount > 0 ? min (temp->estimate, (double) limitCount) : temp->estimate;
+		RegisterMemory (root, limitCount > 0 ? root->estimate : temp->estimate, governor, memoryConsumers);
+		
+		for (int i = 0; i < ((OrderByNode *) root)->order.numAtts; i++) {
+			
+			if (((OrderByNode *) root)->order.whichAtts[i] == -1) {
+				
+				cout << "ERROR: Could not find ORDER BY attribute" << endl;
+				return 1;
+				
+			}
+			
+		}
+		
+		temp = root;
+		
+	}
     if (attsToSelect) 
 	{
 		
@@ -221,9 +283,18 @@ int main () {
 		
 	}
 	
+	for (auto consumer = memoryConsumers.begin (); consumer != memoryConsumers.end (); consumer++) {
+		
+		(*consumer)->memoryShare = governor.GetShare ((*consumer)->memoryId);
+		
+	}
+	
 	cout << "Parse Tree : " << endl;
 	root->Print ();
 	
+	cout << endl;
+	governor.Print ();
+	
 	return 0;
 	
 }